@@ -0,0 +1,85 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <print>
+
+// Scaling microbenchmark for disjoint but adjacent resources: thread t locks and
+// unlocks resource t in a loop, so no two threads ever conflict and any slowdown
+// as threads are added comes from shared cache lines. Prints one line per thread
+// count with total throughput and the speedup over a single thread.
+//
+// The latency mode runs one thread on the uncontended path alone: each transaction
+// locks the same 64 resources and finishes, and the time per lock acquire and per
+// lock released by finish_transaction is printed in nanoseconds.
+//
+// usage: bench00 [max_threads] [milliseconds per run]
+//        bench00 latency [transactions]
+// Build with -DLOCKMANAGER_TRACE_LEVEL=0 to measure the lock manager, not tracing.
+
+double run(int threads, std::chrono::milliseconds duration) {
+    LockManager lm(threads);
+    std::atomic<bool> start{false}, stop{false};
+    std::vector<std::uint64_t> ops(threads);
+    {
+        std::vector<std::jthread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                while (!start) std::this_thread::yield();
+                std::uint64_t n = 0;
+                for (; !stop; n++) {
+                    lm.begin_transaction(t);
+                    lm.write_lock(t, t);
+                    lm.finish_transaction(t);
+                }
+                ops[t] = n;
+            });
+        }
+        start = true;
+        std::this_thread::sleep_for(duration);
+        stop = true;
+    }
+    std::uint64_t total = 0;
+    for (std::uint64_t n : ops) total += n;
+    return total / std::chrono::duration<double>(duration).count();
+}
+
+void latency(int transactions) {
+    constexpr ResourceId LOCKS = 64;
+    LockManager lm(1);
+    std::chrono::steady_clock::duration acquiring{}, releasing{};
+    for (int i = 0; i < transactions; i++) {
+        lm.begin_transaction(0);
+        auto start = std::chrono::steady_clock::now();
+        for (ResourceId rid = 0; rid < LOCKS; rid++) {
+            lm.acquire(0, rid, LockMode::X);
+        }
+        auto locked = std::chrono::steady_clock::now();
+        lm.finish_transaction(0);
+        acquiring += locked - start;
+        releasing += std::chrono::steady_clock::now() - locked;
+    }
+    double locks = static_cast<double>(transactions) * LOCKS;
+    std::println("operation,ns");
+    std::println("acquire,{:.1f}", std::chrono::duration<double, std::nano>(acquiring).count() / locks);
+    std::println("release,{:.1f}", std::chrono::duration<double, std::nano>(releasing).count() / locks);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "latency") == 0) {
+        latency(argc > 2 ? std::atoi(argv[2]) : 100000);
+        return 0;
+    }
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency());
+    std::chrono::milliseconds duration(argc > 2 ? std::atoi(argv[2]) : 1000);
+    double base = 0;
+    std::println("threads,ops_per_sec,speedup");
+    for (int threads = 1; threads <= std::max(max_threads, 1); threads *= 2) {
+        double rate = run(threads, duration);
+        if (threads == 1) base = rate;
+        std::println("{},{:.0f},{:.2f}", threads, rate, rate / base);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "lockmanager.h"
+#include "lockrecorder.h"
+#include "zipf.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <cstring>
+#include <random>
+#include <string>
+#include <print>
+
+// Throughput and latency benchmark. Every thread runs a fixed number of transactions
+// of txn_len lock requests each, on resources drawn from a Zipfian distribution, then
+// commits; an aborted transaction begins again with the same requests. Each thread has
+// its own seeded generator, so a configuration always issues the same requests.
+//
+// usage: bench01 [--threads=N] [--resources=N] [--read_ratio=F] [--theta=F] [--txn_len=N]
+//                [--txns=N] [--policy=detect|detect_bg|wait_die|wound_wait|no_wait]
+//                [--seed=N] [--header=0|1] [--record=FILE]
+// Prints a CSV header and one row: configuration, transactions per second, abort rate
+// and acquire latency percentiles in nanoseconds. --record writes the lock events of the
+// run to FILE for bench03 to replay. Build with -DLOCKMANAGER_TRACE_LEVEL=0.
+
+struct Config {
+    int threads = 4;
+    std::uint64_t resources = 1000;
+    double read_ratio = 0.8;
+    double theta = 0.0;                                 // 0 uniform, towards 1 increasingly skewed
+    int txn_len = 8;
+    int txns = 10000;                                   // per thread
+    std::string policy = "detect";
+    std::uint64_t seed = 1;
+    bool header = true;
+    std::string record;                                 // lock event trace file, none if empty
+};
+
+static bool parse(Config& config, const char* arg) {
+    auto value = [arg](const char* name) -> const char* {
+        std::size_t len = std::strlen(name);
+        return std::strncmp(arg, name, len) == 0 && arg[len] == '=' ? arg + len + 1 : nullptr;
+    };
+    if (const char* v = value("--threads")) config.threads = std::atoi(v);
+    else if (const char* v = value("--resources")) config.resources = std::strtoull(v, nullptr, 10);
+    else if (const char* v = value("--read_ratio")) config.read_ratio = std::atof(v);
+    else if (const char* v = value("--theta")) config.theta = std::atof(v);
+    else if (const char* v = value("--txn_len")) config.txn_len = std::atoi(v);
+    else if (const char* v = value("--txns")) config.txns = std::atoi(v);
+    else if (const char* v = value("--policy")) config.policy = v;
+    else if (const char* v = value("--seed")) config.seed = std::strtoull(v, nullptr, 10);
+    else if (const char* v = value("--header")) config.header = std::atoi(v) != 0;
+    else if (const char* v = value("--record")) config.record = v;
+    else return false;
+    return true;
+}
+
+static bool deadlock_options(const std::string& policy, DeadlockOptions& options) {
+    if (policy == "detect") options.policy = DeadlockPolicy::DETECT;
+    else if (policy == "detect_bg") options.mode = DetectionMode::BACKGROUND;
+    else if (policy == "wait_die") options.policy = DeadlockPolicy::WAIT_DIE;
+    else if (policy == "wound_wait") options.policy = DeadlockPolicy::WOUND_WAIT;
+    else if (policy == "no_wait") options.policy = DeadlockPolicy::NO_WAIT;
+    else return false;
+    return true;
+}
+
+struct ThreadResult {
+    std::uint64_t commits = 0;
+    std::uint64_t aborts = 0;
+    LatencyHistogram latency;
+};
+
+static void worker(LockManager& lm, const Config& config, const Zipf& zipf, int tid, ThreadResult& result) {
+    std::mt19937_64 rng(config.seed * 1000003 + tid);
+    std::vector<LockSpec> requests(config.txn_len);
+    for (int i = 0; i < config.txns; i++) {
+        for (LockSpec& req : requests) {
+            req.rid = zipf(rng);
+            req.mode = std::uniform_real_distribution<double>(0, 1)(rng) < config.read_ratio ? LockMode::S : LockMode::X;
+        }
+        for (;;) {
+            lm.begin_transaction(tid);
+            bool aborted = false;
+            for (const LockSpec& req : requests) {
+                auto start = std::chrono::steady_clock::now();
+                LockResult status = lm.acquire(tid, req.rid, req.mode);
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                result.latency.count++;
+                result.latency.total_ns += ns;
+                result.latency.buckets[LatencyHistogram::bucket_of(ns)]++;
+                if (status != LockResult::GRANTED) {
+                    aborted = true;
+                    break;
+                }
+            }
+            if (!aborted) break;
+            result.aborts++;
+        }
+        lm.finish_transaction(tid);
+        result.commits++;
+    }
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        if (!parse(config, argv[i])) {
+            std::println(stderr, "unknown argument {}", argv[i]);
+            return 1;
+        }
+    }
+    DeadlockOptions options;
+    if (!deadlock_options(config.policy, options) || config.threads < 1 || config.resources < 2) {
+        std::println(stderr, "invalid configuration");
+        return 1;
+    }
+
+    Zipf zipf(config.resources, config.theta);
+    std::vector<ThreadResult> results(config.threads);
+    std::unique_ptr<LockRecorder> recorder;
+    if (!config.record.empty()) {
+        // begin, finish and a request, grant and release per lock, with room for restarts
+        std::size_t events = static_cast<std::size_t>(config.threads) * config.txns * (3 * config.txn_len + 2);
+        recorder = std::make_unique<LockRecorder>(config.record, 2 * events);
+    }
+    auto start = std::chrono::steady_clock::now();
+    {
+        LockManager lm(config.threads, LockManager::DEFAULT_PARTITIONS, options);
+        lm.set_recorder(recorder.get());
+        std::vector<std::jthread> threads;
+        for (int tid = 0; tid < config.threads; tid++) {
+            threads.emplace_back(worker, std::ref(lm), std::cref(config), std::cref(zipf), tid, std::ref(results[tid]));
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (recorder && recorder->dropped()) {
+        std::println(stderr, "{} lock events did not fit in {}", recorder->dropped(), config.record);
+    }
+
+    ThreadResult total;
+    for (const ThreadResult& r : results) {
+        total.commits += r.commits;
+        total.aborts += r.aborts;
+        total.latency.count += r.latency.count;
+        total.latency.total_ns += r.latency.total_ns;
+        for (std::size_t b = 0; b < LatencyHistogram::BUCKETS; b++) total.latency.buckets[b] += r.latency.buckets[b];
+    }
+
+    if (config.header) {
+        std::println("threads,resources,read_ratio,theta,txn_len,policy,commits,aborts,seconds,tps,abort_rate,"
+                     "p50_ns,p99_ns,p999_ns");
+    }
+    std::println("{},{},{},{},{},{},{},{},{:.3f},{:.0f},{:.4f},{},{},{}", config.threads, config.resources,
+                 config.read_ratio, config.theta, config.txn_len, config.policy, total.commits, total.aborts,
+                 seconds, total.commits / seconds,
+                 static_cast<double>(total.aborts) / (total.commits + total.aborts),
+                 total.latency.percentile(0.5).count(), total.latency.percentile(0.99).count(),
+                 total.latency.percentile(0.999).count());
+    return 0;
+}
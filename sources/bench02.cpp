@@ -0,0 +1,142 @@
+#include "occ.h"
+#include "zipf.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <print>
+
+// OCC against 2PL across contention levels. For each skew in the sweep, the same
+// workload runs once under each engine: every thread runs txns transactions of txn_len
+// operations on Zipfian resources, a read_ratio share of them reads and the rest
+// read-modify-writes, and an aborted transaction begins again with the same
+// operations. 2PL takes an S or X lock per operation; OCC reads versions, buffers
+// its writes and validates at commit.
+//
+// usage: bench02 [--threads=N] [--resources=N] [--read_ratio=F] [--txn_len=N]
+//                [--txns=N] [--seed=N] [--theta=F]
+// Without --theta the skew is swept from uniform to highly skewed. Prints one CSV row
+// per engine and skew. Build with -DLOCKMANAGER_TRACE_LEVEL=0.
+
+struct Config {
+    int threads = 4;
+    std::uint64_t resources = 1000;
+    double read_ratio = 0.8;
+    int txn_len = 8;
+    int txns = 10000;                                   // per thread
+    std::uint64_t seed = 1;
+    std::vector<double> thetas{0.0, 0.5, 0.8, 0.9, 0.99};
+};
+
+struct Op {
+    ResourceId rid;
+    bool write;
+};
+
+static bool parse(Config& config, const char* arg) {
+    auto value = [arg](const char* name) -> const char* {
+        std::size_t len = std::strlen(name);
+        return std::strncmp(arg, name, len) == 0 && arg[len] == '=' ? arg + len + 1 : nullptr;
+    };
+    if (const char* v = value("--threads")) config.threads = std::atoi(v);
+    else if (const char* v = value("--resources")) config.resources = std::strtoull(v, nullptr, 10);
+    else if (const char* v = value("--read_ratio")) config.read_ratio = std::atof(v);
+    else if (const char* v = value("--txn_len")) config.txn_len = std::atoi(v);
+    else if (const char* v = value("--txns")) config.txns = std::atoi(v);
+    else if (const char* v = value("--seed")) config.seed = std::strtoull(v, nullptr, 10);
+    else if (const char* v = value("--theta")) config.thetas = {std::atof(v)};
+    else return false;
+    return true;
+}
+
+// true once committed, false when the attempt aborted
+static bool run_2pl(LockManager& lm, int tid, const std::vector<Op>& ops) {
+    lm.begin_transaction(tid);
+    for (const Op& op : ops) {
+        if (lm.acquire(tid, op.rid, op.write ? LockMode::X : LockMode::S) != LockResult::GRANTED) return false;
+    }
+    lm.finish_transaction(tid);
+    return true;
+}
+
+static bool run_occ(OccManager& occ, int tid, const std::vector<Op>& ops) {
+    occ.begin_transaction(tid);
+    try {
+        for (const Op& op : ops) {
+            occ.read(tid, op.rid);
+            if (op.write) occ.write(tid, op.rid);
+        }
+    } catch (const std::exception&) {
+        return false;   // waited too long for a resource being written
+    }
+    return occ.commit_transaction(tid) == LockResult::GRANTED;
+}
+
+struct RunResult {
+    std::uint64_t commits = 0;
+    std::uint64_t aborts = 0;
+    double seconds = 0;
+};
+
+static RunResult run(const Config& config, const Zipf& zipf, bool optimistic) {
+    LockManager lm(config.threads);
+    OccManager occ(lm, config.threads);
+    std::vector<RunResult> results(config.threads);
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (int tid = 0; tid < config.threads; tid++) {
+            threads.emplace_back([&, tid] {
+                std::mt19937_64 rng(config.seed * 1000003 + tid);
+                std::vector<Op> ops(config.txn_len);
+                for (int i = 0; i < config.txns; i++) {
+                    for (Op& op : ops) {
+                        op.rid = zipf(rng);
+                        op.write = std::uniform_real_distribution<double>(0, 1)(rng) >= config.read_ratio;
+                    }
+                    while (!(optimistic ? run_occ(occ, tid, ops) : run_2pl(lm, tid, ops))) {
+                        results[tid].aborts++;
+                    }
+                    results[tid].commits++;
+                }
+            });
+        }
+    }
+    RunResult total;
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const RunResult& r : results) {
+        total.commits += r.commits;
+        total.aborts += r.aborts;
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        if (!parse(config, argv[i])) {
+            std::println(stderr, "unknown argument {}", argv[i]);
+            return 1;
+        }
+    }
+    if (config.threads < 1 || config.resources < 2) {
+        std::println(stderr, "invalid configuration");
+        return 1;
+    }
+
+    std::println("engine,threads,resources,read_ratio,theta,txn_len,commits,aborts,seconds,tps,abort_rate");
+    for (double theta : config.thetas) {
+        Zipf zipf(config.resources, theta);
+        for (bool optimistic : {false, true}) {
+            RunResult r = run(config, zipf, optimistic);
+            std::println("{},{},{},{},{},{},{},{},{:.3f},{:.0f},{:.4f}", optimistic ? "occ" : "2pl", config.threads,
+                         config.resources, config.read_ratio, theta, config.txn_len, r.commits, r.aborts,
+                         r.seconds, r.commits / r.seconds,
+                         static_cast<double>(r.aborts) / (r.commits + r.aborts));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include "lockmanager.h"
+#include "lockrecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <print>
+
+// Replays a lock event trace written by a LockRecorder (see bench01 --record). The
+// trace is cut into sessions, each one transaction from its begin to its finish or
+// abort. Threads take the sessions in the order they began and issue the same lock
+// requests, downgrades and unlocks, each at its original time divided by the speed, or back to
+// back with speed 0. A session ends early when the replay aborts it. A thread runs one
+// session at a time, and sessions start in order, so a lock is only ever held by a
+// session that is running: fewer threads than the trace used stretch the timeline but
+// never leave a request waiting for a session that has not started.
+//
+// usage: bench03 FILE [--threads=N] [--speed=F] [--top=N]
+//                [--policy=detect|detect_bg|wait_die|wound_wait|no_wait]
+// Prints one CSV row per resource, the top N by replay wait time: requests, total wait
+// in the trace (request to grant) and in the replay (time spent in acquire), and the
+// longest replay wait, in microseconds. Build with -DLOCKMANAGER_TRACE_LEVEL=0.
+
+struct Config {
+    std::string file;
+    int threads = 4;
+    double speed = 1.0;                                 // 0 replays without pauses
+    std::size_t top = 20;
+    std::string policy = "detect";
+};
+
+struct Op {
+    std::uint64_t time;
+    LockEventKind kind;                                 // REQUEST, RELEASE, or GRANT for a downgrade
+    ResourceId rid;
+    LockMode mode;
+    bool try_only;
+};
+
+struct Session {
+    std::uint64_t start;
+    std::vector<Op> ops;
+};
+
+struct ResourceWait {
+    std::uint64_t requests = 0;
+    std::uint64_t trace_ns = 0;
+    std::uint64_t replay_ns = 0;
+    std::uint64_t replay_max_ns = 0;
+};
+
+static bool parse(Config& config, const char* arg) {
+    auto value = [arg](const char* name) -> const char* {
+        std::size_t len = std::strlen(name);
+        return std::strncmp(arg, name, len) == 0 && arg[len] == '=' ? arg + len + 1 : nullptr;
+    };
+    if (const char* v = value("--threads")) config.threads = std::atoi(v);
+    else if (const char* v = value("--speed")) config.speed = std::atof(v);
+    else if (const char* v = value("--top")) config.top = std::strtoull(v, nullptr, 10);
+    else if (const char* v = value("--policy")) config.policy = v;
+    else if (arg[0] != '-' && config.file.empty()) config.file = arg;
+    else return false;
+    return true;
+}
+
+static bool deadlock_options(const std::string& policy, DeadlockOptions& options) {
+    if (policy == "detect") options.policy = DeadlockPolicy::DETECT;
+    else if (policy == "detect_bg") options.mode = DetectionMode::BACKGROUND;
+    else if (policy == "wait_die") options.policy = DeadlockPolicy::WAIT_DIE;
+    else if (policy == "wound_wait") options.policy = DeadlockPolicy::WOUND_WAIT;
+    else if (policy == "no_wait") options.policy = DeadlockPolicy::NO_WAIT;
+    else return false;
+    return true;
+}
+
+// Sessions in the order they began, plus the waits the trace itself shows. A session
+// opens at a begin, or at the first request of a transaction that has none open. The
+// unlocks that finish and abort record are left to finish_transaction in the replay.
+static std::vector<Session> load(const LockTrace& trace, std::unordered_map<ResourceId, ResourceWait>& waits) {
+    struct Open {
+        Session* session = nullptr;
+        ResourceId waiting_rid = 0;
+        std::uint64_t waiting_since = 0;
+        bool waiting = false;
+    };
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::unordered_map<int, Open> open;
+    for (const LockEvent& e : trace.events()) {
+        Open& txn = open[e.tid];
+        if (e.kind == LockEventKind::BEGIN || (!txn.session && e.kind == LockEventKind::REQUEST)) {
+            sessions.push_back(std::make_unique<Session>(Session{e.time, {}}));
+            txn = {sessions.back().get()};
+        }
+        if (!txn.session) continue;
+        switch (e.kind) {
+            case LockEventKind::BEGIN:
+                break;
+            case LockEventKind::REQUEST:
+                txn.session->ops.push_back({e.time, e.kind, e.rid, static_cast<LockMode>(e.mode), (e.flags & EVENT_TRY) != 0});
+                txn.waiting = !(e.flags & EVENT_TRY);
+                txn.waiting_rid = e.rid;
+                txn.waiting_since = e.time;
+                waits[e.rid].requests++;
+                break;
+            case LockEventKind::GRANT:
+                if (e.flags & EVENT_DOWNGRADE) {
+                    txn.session->ops.push_back({e.time, e.kind, e.rid, LockMode::S, false});
+                    break;
+                }
+                if (txn.waiting && txn.waiting_rid == e.rid && e.time > txn.waiting_since) {
+                    waits[e.rid].trace_ns += e.time - txn.waiting_since;
+                }
+                txn.waiting = false;
+                break;
+            case LockEventKind::DENY:
+                txn.waiting = false;
+                break;
+            case LockEventKind::RELEASE:
+                if (!(e.flags & EVENT_END)) txn.session->ops.push_back({e.time, e.kind, e.rid, LockMode::IS, false});
+                break;
+            case LockEventKind::ABORT:
+            case LockEventKind::FINISH:
+                txn = {};
+                break;
+        }
+    }
+    std::stable_sort(sessions.begin(), sessions.end(), [](const auto& a, const auto& b) { return a->start < b->start; });
+    std::vector<Session> ordered;
+    ordered.reserve(sessions.size());
+    for (auto& s : sessions) ordered.push_back(std::move(*s));
+    return ordered;
+}
+
+int main(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        if (!parse(config, argv[i])) {
+            std::println(stderr, "unknown argument {}", argv[i]);
+            return 1;
+        }
+    }
+    DeadlockOptions options;
+    if (config.file.empty() || !deadlock_options(config.policy, options) || config.threads < 1 || config.speed < 0) {
+        std::println(stderr, "invalid configuration");
+        return 1;
+    }
+
+    LockTrace trace(config.file);
+    std::unordered_map<ResourceId, ResourceWait> waits;
+    std::vector<Session> sessions = load(trace, waits);
+    if (trace.dropped()) std::println(stderr, "the trace lost {} events that did not fit", trace.dropped());
+
+    std::vector<std::unordered_map<ResourceId, ResourceWait>> replay_waits(config.threads);
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::uint64_t> aborts{0};
+    std::uint64_t origin = sessions.empty() ? 0 : sessions.front().start;
+    auto start = std::chrono::steady_clock::now();
+    {
+        LockManager lm(config.threads, LockManager::DEFAULT_PARTITIONS, options);
+        auto pace = [&](std::uint64_t time) {
+            if (config.speed == 0) return;
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(
+                static_cast<std::int64_t>((time - origin) / config.speed)));
+        };
+        std::vector<std::jthread> threads;
+        for (int tid = 0; tid < config.threads; tid++) {
+            threads.emplace_back([&, tid] {
+                std::unordered_set<ResourceId> held;
+                for (std::size_t i = next++; i < sessions.size(); i = next++) {
+                    const Session& session = sessions[i];
+                    pace(session.start);
+                    lm.begin_transaction(tid);
+                    held.clear();
+                    for (const Op& op : session.ops) {
+                        pace(op.time);
+                        if (op.kind == LockEventKind::RELEASE) {
+                            // the trace may have held a lock that a try request did not get here
+                            if (held.erase(op.rid)) lm.release(tid, op.rid);
+                            continue;
+                        }
+                        if (op.kind == LockEventKind::GRANT) {
+                            if (held.count(op.rid)) lm.downgrade_lock(tid, op.rid);
+                            continue;
+                        }
+                        if (op.try_only) {
+                            if (lm.try_acquire(tid, op.rid, op.mode) == LockResult::GRANTED) held.insert(op.rid);
+                            continue;
+                        }
+                        auto before = std::chrono::steady_clock::now();
+                        LockResult result = lm.acquire(tid, op.rid, op.mode);
+                        auto ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - before).count());
+                        ResourceWait& w = replay_waits[tid][op.rid];
+                        w.replay_ns += ns;
+                        w.replay_max_ns = std::max(w.replay_max_ns, ns);
+                        if (result != LockResult::GRANTED) {
+                            aborts++;
+                            break;
+                        }
+                        held.insert(op.rid);
+                    }
+                    lm.finish_transaction(tid);
+                }
+            });
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::println(stderr, "replayed {} sessions of {} events in {:.3f} s, {} aborted", sessions.size(),
+                 trace.events().size(), seconds, aborts.load());
+
+    for (const auto& thread_waits : replay_waits) {
+        for (const auto& [rid, w] : thread_waits) {
+            ResourceWait& total = waits[rid];
+            total.replay_ns += w.replay_ns;
+            total.replay_max_ns = std::max(total.replay_max_ns, w.replay_max_ns);
+        }
+    }
+    std::vector<std::pair<ResourceId, ResourceWait>> rows(waits.begin(), waits.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.replay_ns != b.second.replay_ns ? a.second.replay_ns > b.second.replay_ns : a.first < b.first;
+    });
+    rows.resize(std::min(rows.size(), config.top));
+
+    std::println("rid,requests,trace_wait_us,replay_wait_us,replay_max_us");
+    for (const auto& [rid, w] : rows) {
+        std::println("{},{},{:.1f},{:.1f},{:.1f}", rid, w.requests, w.trace_ns / 1e3, w.replay_ns / 1e3,
+                     w.replay_max_ns / 1e3);
+    }
+    return 0;
+}
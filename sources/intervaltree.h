@@ -0,0 +1,132 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <utility>
+
+// Closed intervals over 64-bit keys, each carrying a value. A treap ordered by the
+// low end, where every node also knows the highest high end in its subtree, so a
+// query for the intervals overlapping [low, high] skips every subtree that ends
+// before low or starts after high: O(log n + k) expected for k results. Intervals
+// are identified by the id insert returns.
+
+template <typename T>
+class IntervalTree {
+public:
+    using Key = std::uint64_t;
+
+    std::uint64_t insert(Key low, Key high, T value) {
+        std::uint64_t id = ++last_id;
+        auto node = std::make_unique<Node>(low, high, id, static_cast<std::uint32_t>(rng()), std::move(value));
+        root = insert(std::move(root), std::move(node));
+        count++;
+        return id;
+    }
+
+    // false if no interval with that low end and id is stored
+    bool erase(Key low, std::uint64_t id) {
+        bool found = false;
+        root = erase(std::move(root), low, id, found);
+        count -= found;
+        return found;
+    }
+
+    // calls f(low, high, value) for every stored interval that overlaps [low, high]
+    template <typename F>
+    void overlapping(Key low, Key high, F&& f) const {
+        overlapping(root.get(), low, high, f);
+    }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+private:
+    struct Node {
+        Key low, high, max_high;
+        std::uint64_t id;
+        std::uint32_t priority;                         // max-heap order
+        T value;
+        std::unique_ptr<Node> left, right;
+
+        Node(Key low, Key high, std::uint64_t id, std::uint32_t priority, T value)
+            : low(low), high(high), max_high(high), id(id), priority(priority), value(std::move(value)) {}
+
+        void update() {
+            max_high = high;
+            if (left) max_high = std::max(max_high, left->max_high);
+            if (right) max_high = std::max(max_high, right->max_high);
+        }
+
+        bool before(Key l, std::uint64_t i) const { return low < l || (low == l && id < i); }
+    };
+
+    std::unique_ptr<Node> root;
+    std::size_t count = 0;
+    std::uint64_t last_id = 0;
+    std::minstd_rand rng;
+
+    static std::unique_ptr<Node> rotate_right(std::unique_ptr<Node> n) {
+        std::unique_ptr<Node> l = std::move(n->left);
+        n->left = std::move(l->right);
+        n->update();
+        l->right = std::move(n);
+        l->update();
+        return l;
+    }
+
+    static std::unique_ptr<Node> rotate_left(std::unique_ptr<Node> n) {
+        std::unique_ptr<Node> r = std::move(n->right);
+        n->right = std::move(r->left);
+        n->update();
+        r->left = std::move(n);
+        r->update();
+        return r;
+    }
+
+    static std::unique_ptr<Node> insert(std::unique_ptr<Node> n, std::unique_ptr<Node> node) {
+        if (!n) return node;
+        if (node->before(n->low, n->id)) {
+            n->left = insert(std::move(n->left), std::move(node));
+            if (n->left->priority > n->priority) return rotate_right(std::move(n));
+        } else {
+            n->right = insert(std::move(n->right), std::move(node));
+            if (n->right->priority > n->priority) return rotate_left(std::move(n));
+        }
+        n->update();
+        return n;
+    }
+
+    static std::unique_ptr<Node> erase(std::unique_ptr<Node> n, Key low, std::uint64_t id, bool& found) {
+        if (!n) return n;
+        if (n->low == low && n->id == id) {
+            found = true;
+            // rotate the node down until it has at most one child, then splice it out
+            if (!n->left) return std::move(n->right);
+            if (!n->right) return std::move(n->left);
+            if (n->left->priority > n->right->priority) {
+                n = rotate_right(std::move(n));
+                n->right = erase(std::move(n->right), low, id, found);
+            } else {
+                n = rotate_left(std::move(n));
+                n->left = erase(std::move(n->left), low, id, found);
+            }
+        } else if (n->before(low, id)) {
+            n->right = erase(std::move(n->right), low, id, found);
+        } else {
+            n->left = erase(std::move(n->left), low, id, found);
+        }
+        n->update();
+        return n;
+    }
+
+    template <typename F>
+    static void overlapping(const Node* n, Key low, Key high, F& f) {
+        while (n && n->max_high >= low) {
+            overlapping(n->left.get(), low, high, f);
+            if (n->low > high) return;                  // everything to the right starts later still
+            if (n->high >= low) f(n->low, n->high, n->value);
+            n = n->right.get();
+        }
+    }
+};
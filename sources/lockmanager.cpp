@@ -1,297 +1,1893 @@
 #include "lockmanager.h"
+#include "lockrecorder.h"
 
-LockManager::LockManager() {
-    graph.resize(N);
-    transaction_phase.resize(N, Phase::GROWING);
-    locks_held.resize(N);
-    for (int i = 0; i < M; i++) {
-        state[i] = LockState::UNLOCKED;
+const char* mode_name(LockMode mode) {
+    switch (mode) {
+        case LockMode::IS:  return "IS";
+        case LockMode::IX:  return "IX";
+        case LockMode::S:   return "read";
+        case LockMode::SIX: return "SIX";
+        case LockMode::X:   return "write";
     }
+    return "?";
 }
 
-void LockManager::begin_transaction(int tid) {
-    transaction_phase[tid] = Phase::GROWING;
-    std::println("Transaction {} has begun", tid);
+const char* result_name(LockResult result) {
+    switch (result) {
+        case LockResult::GRANTED:            return "granted";
+        case LockResult::WOULD_BLOCK:        return "would block";
+        case LockResult::DEADLOCK_VICTIM:    return "deadlock victim";
+        case LockResult::TIMEOUT:            return "timeout";
+        case LockResult::PENDING:            return "pending";
+        case LockResult::PROTOCOL_VIOLATION: return "protocol violation";
+        case LockResult::VALIDATION_FAILED:  return "validation failed";
+        case LockResult::OUT_OF_SPACE:       return "out of space";
+    }
+    return "?";
+}
+
+bool LockEntry::grantable(LockMode mode, int tid) const {
+    auto own = holders.find(tid);
+    for (int m = 0; m < 5; m++) {
+        int others = granted[m] - (own != holders.end() && static_cast<int>(own->second) == m);
+        if (others > 0 && !compatible(mode, static_cast<LockMode>(m))) return false;
+    }
+    return true;
+}
+
+void LockEntry::grant(int tid, LockMode mode) {
+    auto [it, inserted] = holders.try_emplace(tid, mode);
+    if (!inserted) {
+        granted[static_cast<int>(it->second)]--;
+        it->second = mode;
+    }
+    granted[static_cast<int>(mode)]++;
+}
+
+void LockEntry::revoke(int tid) {
+    auto it = holders.find(tid);
+    if (it != holders.end()) {
+        granted[static_cast<int>(it->second)]--;
+        holders.erase(it);
+    }
+}
+
+void WaitQueue::insert(LockRequest* before, LockRequest& req) {
+    req.next = before;
+    req.prev = before ? before->prev : tail;
+    (req.prev ? req.prev->next : head) = &req;
+    (before ? before->prev : tail) = &req;
+    req.queued = true;
+}
+
+void WaitQueue::erase(LockRequest& req) {
+    (req.prev ? req.prev->next : head) = req.next;
+    (req.next ? req.next->prev : tail) = req.prev;
+    req.prev = req.next = nullptr;
+    req.queued = false;
+}
+
+void LockEntry::inflate() {
+    std::uint64_t s = state.load(std::memory_order_acquire);
+    while (s != INFLATED) {
+        if (state.compare_exchange_weak(s, INFLATED, std::memory_order_acq_rel)) {
+            if (s != 0) {
+                grant(static_cast<int>((s & 0xFFFFFFFFu) - 1), static_cast<LockMode>(s >> 32));
+            }
+            return;
+        }
+    }
+}
+
+void LockEntry::deflate_if_idle() {
+    if (state.load(std::memory_order_relaxed) == INFLATED && holders.empty() && wait_queue.empty()) {
+        state.store(0, std::memory_order_release);
+    }
+}
+
+bool LockEntry::try_pin(ResourceId resource) {
+    if (rid.load(std::memory_order_relaxed) != resource) return false;
+    int pins = pin_count.load(std::memory_order_relaxed);
+    do {
+        if (pins == RETIRED) return false;
+    } while (!pin_count.compare_exchange_weak(pins, pins + 1, std::memory_order_acquire, std::memory_order_relaxed));
+    // retired and reused for another resource between the check and the pin
+    if (rid.load(std::memory_order_acquire) == resource) return true;
+    unpin();
+    return false;
+}
+
+LockMode* LockList::find(ResourceId rid) {
+    Item* item = lookup(rid);
+    return item ? &item->mode : nullptr;
+}
+
+void LockList::set(ResourceId rid, LockMode mode, LockEntry* entry) {
+    if (Item* item = lookup(rid)) {
+        item->mode = mode;
+        return;
+    }
+    items.push_back({rid, mode, true, entry});
+    count++;
+    if (!indexed) {
+        if (items.size() > INDEX_THRESHOLD) rebuild_index();
+    } else if (items.size() * 2 > index.size()) {
+        rebuild_index();
+    } else {
+        index_insert(rid, static_cast<std::uint32_t>(items.size() - 1));
+    }
+}
+
+const LockList::Item* LockList::erase(ResourceId rid) {
+    // leave a tombstone so the acquisition order and index positions stay valid
+    Item* item = lookup(rid);
+    if (!item) return nullptr;
+    item->live = false;
+    count--;
+    return item;
+}
+
+void LockList::clear() {
+    items.clear();
+    count = 0;
+    indexed = false;
+    if (++generation == 0) {
+        std::fill(index.begin(), index.end(), Slot{0, 0, 0});
+        generation = 1;
+    }
+}
+
+LockList::Item* LockList::lookup(ResourceId rid) {
+    if (!indexed) {
+        for (Item& item : items) {
+            if (item.rid == rid && item.live) return &item;
+        }
+        return nullptr;
+    }
+    std::size_t mask = index.size() - 1;
+    for (std::size_t i = (rid * 0x9E3779B97F4A7C15ull >> 32) & mask; ; i = (i + 1) & mask) {
+        const Slot& slot = index[i];
+        if (slot.generation != generation) return nullptr;
+        if (slot.rid == rid) {
+            Item& item = items[slot.pos];
+            return item.live ? &item : nullptr;
+        }
+    }
+}
+
+void LockList::index_insert(ResourceId rid, std::uint32_t pos) {
+    std::size_t mask = index.size() - 1;
+    for (std::size_t i = (rid * 0x9E3779B97F4A7C15ull >> 32) & mask; ; i = (i + 1) & mask) {
+        Slot& slot = index[i];
+        if (slot.generation != generation || slot.rid == rid) {
+            slot = {rid, pos, generation};
+            return;
+        }
+    }
+}
+
+void LockList::rebuild_index() {
+    // keep the load factor at or below a quarter after a rebuild
+    std::size_t capacity = std::bit_ceil(items.size() * 4);
+    if (index.size() < capacity) {
+        index.assign(capacity, Slot{0, 0, 0});
+    } else if (++generation == 0) {
+        std::fill(index.begin(), index.end(), Slot{0, 0, 0});
+        generation = 1;
+    }
+    indexed = true;
+    for (std::size_t pos = 0; pos < items.size(); pos++) {
+        if (items[pos].live) index_insert(items[pos].rid, static_cast<std::uint32_t>(pos));
+    }
+}
+
+LockManager::LockManager(int num_transactions, std::size_t num_partitions, DeadlockOptions deadlock_options,
+                         EscalationOptions escalation)
+    : num_transactions(num_transactions), deadlock_options(std::move(deadlock_options)), escalation(escalation) {
+    num_partitions = std::bit_ceil(std::max<std::size_t>(num_partitions, 1));
+    partitions = std::make_unique<LockPartition[]>(num_partitions);
+    partition_mask = num_partitions - 1;
+    transactions = std::make_unique<Transaction[]>(num_transactions);
+    for (int tid = num_transactions - 1; tid >= 0; tid--) {
+        push_free(tid);
+    }
+    waits_for.resize(num_transactions);
+    visit_epoch.resize(num_transactions, 0);
+
+    if (this->deadlock_options.policy == DeadlockPolicy::DETECT &&
+        this->deadlock_options.mode == DetectionMode::BACKGROUND) {
+        detector = std::jthread([this](std::stop_token stop) { run_detector(stop); });
+    }
+}
+
+LockManager::~LockManager() {
+    if (detector.joinable()) {
+        detector.request_stop();
+        detector.join();
+    }
+    trace_flush();   // scenario output is complete once the manager goes away
+}
+
+std::size_t LockManager::partition_index(ResourceId rid) const {
+    // Fibonacci hashing spreads sequential rids across partitions
+    return (rid * 0x9E3779B97F4A7C15ull >> 32) & partition_mask;
+}
+
+bool LockManager::release_before(const LockList::Item& a, const LockList::Item& b) const {
+    // rows, then pages, then tables, so no lock goes before the finer ones it covers;
+    // flat rids have no ancestors and go with the rows. Within a level, by partition.
+    auto level = [](ResourceId rid) {
+        Granularity g = granularity(rid);
+        return g == Granularity::FLAT ? Granularity::ROW : g;
+    };
+    Granularity la = level(a.rid), lb = level(b.rid);
+    if (la != lb) return la > lb;
+    return partition_index(a.rid) < partition_index(b.rid);
+}
+
+LockPartition& LockManager::partition_of(ResourceId rid) {
+    return partitions[partition_index(rid)];
+}
+
+std::size_t LockManager::hot_slot(ResourceId rid) {
+    // bits of the hash above the ones that pick the partition
+    return (rid * 0x9E3779B97F4A7C15ull >> 48) & (LockPartition::HOT_SLOTS - 1);
+}
+
+LockEntry& LockManager::pin_entry(ResourceId rid) {
+    // a resource locked recently is pinned through the hot cache, without the latch
+    LockPartition& p = partition_of(rid);
+    LockEntry* cached = p.hot[hot_slot(rid)].load(std::memory_order_acquire);
+    if (cached && cached->try_pin(rid)) return *cached;
+    std::unique_lock<std::mutex> latch(p.latch);
+    return pin_locked(p, rid);
+}
+
+LockEntry& LockManager::pin_locked(LockPartition& p, ResourceId rid) {
+    LockEntry* entry;
+    auto it = p.table.find(rid);
+    if (it != p.table.end()) {
+        entry = it->second;
+        entry->pin_count.fetch_add(1, std::memory_order_acquire);
+    } else {
+        if (p.table.size() >= p.sweep_at) sweep(p);
+        if (p.spare.empty()) {
+            p.entries.push_back(std::make_unique<LockEntry>());
+            entry = p.entries.back().get();
+        } else {
+            entry = p.spare.back();
+            p.spare.pop_back();
+        }
+        entry->rid.store(rid, std::memory_order_relaxed);
+        entry->pin_count.store(1, std::memory_order_release);
+        p.table.emplace(rid, entry);
+    }
+    std::atomic<LockEntry*>& hot = p.hot[hot_slot(rid)];
+    if (hot.load(std::memory_order_relaxed) != entry) hot.store(entry, std::memory_order_release);
+    return *entry;
+}
+
+void LockManager::sweep(LockPartition& p) {
+    // with the latch held; an idle entry pinned again meanwhile fails the swing and stays
+    std::size_t idle = 0;
+    for (auto it = p.table.begin(); it != p.table.end(); ) {
+        LockEntry* entry = it->second;
+        int unpinned = 0;
+        if (entry->pin_count.load(std::memory_order_relaxed) == 0 && ++idle > LockPartition::MAX_IDLE &&
+            entry->pin_count.compare_exchange_strong(unpinned, LockEntry::RETIRED, std::memory_order_acq_rel)) {
+            LockEntry* cached = entry;
+            p.hot[hot_slot(it->first)].compare_exchange_strong(cached, nullptr, std::memory_order_relaxed);
+            p.spare.push_back(entry);
+            it = p.table.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    p.sweep_at = std::max(2 * p.table.size(), LockPartition::MAX_IDLE);
+}
+
+std::size_t LockManager::live_entries() {
+    // entries somebody holds or waits for; idle cached ones do not count
+    std::size_t count = 0;
+    for (std::size_t i = 0; i <= partition_mask; i++) {
+        std::unique_lock<std::mutex> latch(partitions[i].latch);
+        for (const auto& [rid, entry] : partitions[i].table) {
+            count += entry->pin_count.load(std::memory_order_relaxed) > 0;
+        }
+    }
+    return count;
+}
+
+void LockManager::begin_transaction(int tid, std::chrono::steady_clock::duration lock_timeout) {
+    transactions[tid].phase = Phase::GROWING;
+    transactions[tid].escalate_at = 0;
+    transactions[tid].lock_timeout = lock_timeout;
+    transactions[tid].abort_requested = false;
+    transactions[tid].stats.started = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (!transactions[tid].stats.restarted) {
+        transactions[tid].stats.timestamp = ++next_timestamp;
+    }
+    transactions[tid].stats.restarted = false;
+    transactions[tid].stats.locks_acquired = 0;
+    if (recorder) recorder->record(LockEventKind::BEGIN, tid);
+    trace<TraceLevel::INFO>("Transaction {} has begun", tid);
+}
+
+void LockManager::push_free(int tid) {
+    std::uint64_t head = free_head.load(std::memory_order_relaxed);
+    std::uint64_t next;
+    do {
+        transactions[tid].next_free.store(static_cast<int>(head & 0xFFFFFFFF) - 1, std::memory_order_relaxed);
+        next = ((head >> 32) + 1) << 32 | static_cast<std::uint64_t>(tid + 1);
+    } while (!free_head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+int LockManager::pop_free() {
+    std::uint64_t head = free_head.load(std::memory_order_acquire);
+    for (;;) {
+        int tid = static_cast<int>(head & 0xFFFFFFFF) - 1;
+        if (tid < 0) return -1;
+        int after = transactions[tid].next_free.load(std::memory_order_relaxed);
+        std::uint64_t next = ((head >> 32) + 1) << 32 | static_cast<std::uint64_t>(after + 1);
+        if (free_head.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+            return tid;
+        }
+    }
+}
+
+TxnHandle LockManager::begin_transaction(std::chrono::steady_clock::duration lock_timeout) {
+    int tid = pop_free();
+    if (tid < 0) {
+        throw std::runtime_error("no free transaction descriptor");
+    }
+    TxnHandle txn{tid, ++next_txn_id};
+    transactions[tid].id = txn.id;
+    transactions[tid].stats.restarted = false;   // the slot's previous owner does not pass on its age
+    begin_transaction(tid, lock_timeout);
+    return txn;
+}
+
+bool LockManager::is_current(TxnHandle txn) const {
+    return txn.slot >= 0 && txn.slot < num_transactions && txn.id != 0 &&
+           transactions[txn.slot].id.load() == txn.id;
+}
+
+bool LockManager::check_handle(TxnHandle txn) const {
+    if (is_current(txn)) return true;
+    trace<TraceLevel::ERROR>("Transaction handle {} is stale, it was already finished", txn.id);
+    return false;
+}
+
+void LockManager::begin_transaction(TxnHandle txn, std::chrono::steady_clock::duration lock_timeout) {
+    if (!check_handle(txn)) {
+        throw std::runtime_error("stale transaction handle");
+    }
+    begin_transaction(txn.slot, lock_timeout);
+}
+
+void LockManager::finish_transaction(TxnHandle txn) {
+    if (!check_handle(txn)) return;
+    finish_transaction(txn.slot);
+    transactions[txn.slot].id = 0;
+    push_free(txn.slot);
+}
+
+void LockManager::abort_transaction(TxnHandle txn) {
+    if (!check_handle(txn)) {
+        throw std::runtime_error("abort_transaction");
+    }
+    abort_transaction(txn.slot);
+}
+
+// A stale handle's slot may be driven by another transaction by now, so it is neither
+// locked on nor rolled back; the handle just gets PROTOCOL_VIOLATION.
+
+LockResult LockManager::acquire(TxnHandle txn, ResourceId rid, LockMode mode) {
+    return check_handle(txn) ? acquire(txn.slot, rid, mode) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::acquire(TxnHandle txn, ResourceId rid, LockMode mode,
+                                std::chrono::steady_clock::duration timeout) {
+    return check_handle(txn) ? acquire(txn.slot, rid, mode, timeout) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::acquire(TxnHandle txn, ResourceId rid, LockMode mode, Deadline deadline) {
+    return check_handle(txn) ? acquire(txn.slot, rid, mode, deadline) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::try_acquire(TxnHandle txn, ResourceId rid, LockMode mode) {
+    return check_handle(txn) ? try_acquire(txn.slot, rid, mode) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::acquire_hierarchy(TxnHandle txn, ResourceId rid, LockMode mode) {
+    return check_handle(txn) ? acquire_hierarchy(txn.slot, rid, mode) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::release(TxnHandle txn, ResourceId rid) {
+    return check_handle(txn) ? release(txn.slot, rid) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::acquire_many(TxnHandle txn, std::span<const LockSpec> requests) {
+    return check_handle(txn) ? acquire_many(txn.slot, requests) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::release_many(TxnHandle txn, std::span<const ResourceId> rids) {
+    return check_handle(txn) ? release_many(txn.slot, rids) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::acquire_range(TxnHandle txn, ResourceId low, ResourceId high, LockMode mode) {
+    return check_handle(txn) ? acquire_range(txn.slot, low, high, mode) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::release_range(TxnHandle txn, ResourceId low, ResourceId high) {
+    return check_handle(txn) ? release_range(txn.slot, low, high) : LockResult::PROTOCOL_VIOLATION;
+}
+
+LockResult LockManager::acquire_async(TxnHandle txn, ResourceId rid, LockMode mode, Executor executor,
+                                      std::function<void(LockResult)> done) {
+    if (!check_handle(txn)) return LockResult::PROTOCOL_VIOLATION;
+    return acquire_async(txn.slot, rid, mode, std::move(executor), std::move(done));
+}
+
+void LockManager::set_lock_timeout(TxnHandle txn, std::chrono::steady_clock::duration timeout) {
+    if (check_handle(txn)) set_lock_timeout(txn.slot, timeout);
+}
+
+void LockManager::lock(TxnHandle txn, ResourceId rid, LockMode mode) {
+    if (acquire(txn, rid, mode) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::read_lock(TxnHandle txn, ResourceId rid) {
+    lock(txn, rid, LockMode::S);
+}
+
+void LockManager::write_lock(TxnHandle txn, ResourceId rid) {
+    lock(txn, rid, LockMode::X);
+}
+
+void LockManager::unlock(TxnHandle txn, ResourceId rid) {
+    if (release(txn, rid) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::lock_many(TxnHandle txn, std::span<const LockSpec> requests) {
+    if (acquire_many(txn, requests) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::unlock_many(TxnHandle txn, std::span<const ResourceId> rids) {
+    if (release_many(txn, rids) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::upgrade_lock(TxnHandle txn, ResourceId rid) {
+    if (!check_handle(txn)) {
+        throw std::runtime_error("abort_transaction");
+    }
+    upgrade_lock(txn.slot, rid);
+}
+
+void LockManager::downgrade_lock(TxnHandle txn, ResourceId rid) {
+    if (!check_handle(txn)) {
+        throw std::runtime_error("abort_transaction");
+    }
+    downgrade_lock(txn.slot, rid);
+}
+
+void LockManager::lock_hierarchy(TxnHandle txn, ResourceId rid, LockMode mode) {
+    if (acquire_hierarchy(txn, rid, mode) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::lock_range(TxnHandle txn, ResourceId low, ResourceId high, LockMode mode) {
+    if (acquire_range(txn, low, high, mode) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::unlock_range(TxnHandle txn, ResourceId low, ResourceId high) {
+    if (release_range(txn, low, high) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
 }
 
 void LockManager::finish_transaction(int tid) {
-    std::println("Transaction {} has finished", tid);
-    std::vector<int> resources_to_release(locks_held[tid].begin(), locks_held[tid].end());
-    for (int rid : resources_to_release) {
-        unlock(tid, rid);
+    trace<TraceLevel::INFO>("Transaction {} has finished", tid);
+    release_all(tid);
+    if (recorder) recorder->record(LockEventKind::FINISH, tid);
+    trace<TraceLevel::INFO>("Transaction {} terminated successfully", tid);
+}
+
+void LockManager::release_all(int tid) {
+    // the list is sorted in place and walked directly, then emptied in one go
+    transactions[tid].phase = Phase::SHRINKING;
+    if (!transactions[tid].ranges.empty()) release_ranges(tid);
+    LockList& held = transactions[tid].locks;
+    held.sort([this](const LockList::Item& a, const LockList::Item& b) { return release_before(a, b); });
+    if (recorder) {
+        for (const LockList::Item& item : held) {
+            if (item.live) recorder->record(LockEventKind::RELEASE, tid, item.rid, item.mode, EVENT_END);
+        }
     }
-    std::println("Transaction {} terminated successfully", tid);
+    release_batch(tid, held.begin(), held.end());
+    held.clear();
+    count_held(tid, -static_cast<std::int64_t>(transactions[tid].stats.locks_held.load()));
 }
 
-void LockManager::abort_transaction(int tid) {
-    std::println("Aborting transaction {}", tid);
-    std::vector<int> resources_to_release(locks_held[tid].begin(), locks_held[tid].end());
-    for (int rid : resources_to_release) {
-        unlock(tid, rid);
+template <typename It>
+void LockManager::release_batch(int tid, It first, It last) {
+    // in the order given, each entry unpinned right after its release
+    for (; first != last; ++first) {
+        if (!first->live) continue;
+        release_entry(tid, *first);
+        first->entry->unpin();
     }
-    graph[tid].clear();
-    transaction_phase[tid] = Phase::GROWING;
+    wake_pending_victims();
+}
+
+void LockManager::rollback(int tid, AbortCause cause) {
+    trace<TraceLevel::ERROR>("Aborting transaction {}", tid);
+    metrics->abort(cause);
+    release_all(tid);
+    if (recorder) recorder->record(LockEventKind::ABORT, tid);
+    clear_wait_edges(tid);
+    transactions[tid].phase = Phase::GROWING;
+    transactions[tid].abort_requested = false;
+    transactions[tid].stats.restarted = true;   // a restart keeps its age so it cannot starve
+}
+
+void LockManager::abort_transaction(int tid) {
+    rollback(tid, AbortCause::USER);
     throw std::runtime_error("abort_transaction");
 }
 
-int LockManager::try_lock(int tid, int rid, bool is_read_lock) {
-    if (transaction_phase[tid] == Phase::SHRINKING) {
-        std::println("Transaction {} in shrinking phase, locking violates 2PL protocol.", tid);
-        return false;
+int LockManager::try_lock(int tid, ResourceId rid, bool is_read_lock) {
+    return try_lock(tid, rid, is_read_lock ? LockMode::S : LockMode::X);
+}
+
+int LockManager::try_lock(int tid, ResourceId rid, LockMode mode) {
+    std::vector<int> blockers;
+    LockResult result = try_acquire(tid, rid, mode, &blockers);
+    if (result != LockResult::WOULD_BLOCK) return result == LockResult::GRANTED;
+    if (deadlock_options.policy != DeadlockPolicy::DETECT) return 0;
+
+    std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
+    std::vector<int> cycle;
+    waits_for[tid] = std::move(blockers);
+    bool deadlock_detected = find_cycle(tid, cycle);
+    waits_for[tid].clear();
+    if (deadlock_detected) {
+        trace<TraceLevel::INFO>("Potential deadlock detected if transaction {} waits for {} lock on resource {}",
+                    tid, mode_name(mode), rid);
+        return -1;
     }
-    
-    if ((is_read_lock && (state[rid] != LockState::WRITE_GRANTED && wait_queue[rid].empty())) || 
-        (!is_read_lock && state[rid] == LockState::UNLOCKED && wait_queue[rid].empty())) {
-            if(is_read_lock)
-            {
-                std::println("Transaction {} can acquire read lock on resource {}", tid, rid);
-                state[rid] = LockState::READ_GRANTED;
-            }
-            else
-            {
-                std::println("Transaction {} can acquire write lock on resource {}", tid, rid);
-                state[rid] = LockState::WRITE_GRANTED;
+    return 0;
+}
+
+LockResult LockManager::try_acquire(int tid, ResourceId rid, LockMode mode) {
+    return try_acquire(tid, rid, mode, nullptr);
+}
+
+LockResult LockManager::try_acquire(int tid, ResourceId rid, LockMode mode, std::vector<int>* blockers) {
+    if (transactions[tid].phase == Phase::SHRINKING) {
+        trace<TraceLevel::ERROR>("Transaction {} in shrinking phase, locking violates 2PL protocol.", tid);
+        return LockResult::PROTOCOL_VIOLATION;
+    }
+    if (recorder) recorder->record(LockEventKind::REQUEST, tid, rid, mode, EVENT_TRY);
+
+    // a conversion works on the entry the transaction keeps pinned while it holds the lock
+    LockList::Item* held_item = transactions[tid].locks.find_item(rid);
+    LockMode* held_mode = held_item ? &held_item->mode : nullptr;
+    LockEntry& entry = held_item ? *held_item->entry : pin_entry(rid);
+    if (held_mode ? entry.try_thin(LockEntry::thin(tid, *held_mode), LockEntry::thin(tid, supremum(*held_mode, mode)))
+                  : entry.try_thin(0, LockEntry::thin(tid, mode))) {
+        LockMode target = held_mode ? supremum(*held_mode, mode) : mode;
+        trace<TraceLevel::DEBUG>("Transaction {} can acquire {} lock on resource {}", tid, mode_name(target), rid);
+        if (recorder) recorder->record(LockEventKind::GRANT, tid, rid, target);
+        transactions[tid].locks.set(rid, target, &entry);
+        count_held(tid, !held_mode);
+        transactions[tid].stats.locks_acquired++;
+        metrics->count(Counter::GRANTS);
+        return LockResult::GRANTED;
+    }
+    {
+        std::unique_lock<std::mutex> lock(entry.mtx);
+        entry.inflate();
+        auto held = entry.holders.find(tid);
+        bool newly_held = held == entry.holders.end();
+        LockMode target = newly_held ? mode : supremum(held->second, mode);
+        bool queue_free = newly_held ? entry.wait_queue.empty()
+                                     : (entry.wait_queue.empty() || !entry.wait_queue.front()->conversion);
+
+        if (queue_free && entry.grantable(target, tid)) {
+            trace<TraceLevel::DEBUG>("Transaction {} can acquire {} lock on resource {}", tid, mode_name(target), rid);
+            if (recorder) recorder->record(LockEventKind::GRANT, tid, rid, target);
+            entry.grant(tid, target);
+            transactions[tid].locks.set(rid, target, &entry);
+            count_held(tid, newly_held);
+            transactions[tid].stats.locks_acquired++;
+            metrics->count(Counter::GRANTS);
+            return LockResult::GRANTED;
+        }
+
+        // the edges we would get if we queued now
+        if (blockers) {
+            for (const auto& [holder, held_mode] : entry.holders) {
+                if (holder != tid && !compatible(target, held_mode)) blockers->push_back(holder);
             }
-        locks_held[tid].insert(rid);
-        return 1;  
+            if (!entry.wait_queue.empty()) blockers->push_back(entry.wait_queue.back()->tid);
+        }
+        entry.deflate_if_idle();
     }
+    if (!held_item) entry.unpin();
 
-    std::println("Resource {} is currently locked, transaction {} cannot immediately acquire {} lock", 
-                rid, tid, (is_read_lock ? "read" : "write"));
-    
-    graph[tid].push_back(rid);
+    if (recorder) recorder->record(LockEventKind::DENY, tid, rid, mode);
+    trace<TraceLevel::DEBUG>("Resource {} is currently locked, transaction {} cannot immediately acquire {} lock",
+                rid, tid, mode_name(mode));
+    return LockResult::WOULD_BLOCK;
+}
 
-    bool deadlock_detected = false;
-    std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
-    
-    std::vector<bool> visited(N, false), rec_stack(N, false);
-    for (int i = 0; i < N; i++) {
-        if (!visited[i]) {
-            std::vector<int> cycle;
-            if (dfs(i, visited, rec_stack, cycle)) {
-                deadlock_detected = true;
-                std::println("Potential deadlock detected if transaction {} waits for {} lock on resource {}", 
-                            tid, (is_read_lock ? "read" : "write"), rid);
-                break;
+LockResult LockManager::wait_for_grant(int tid, ResourceId rid, LockMode mode, LockEntry& entry, Deadline deadline,
+                                       std::unique_lock<std::mutex>& lock) {
+    trace<TraceLevel::INFO>("Transaction {} waiting for {} lock on resource {}", tid, mode_name(mode), rid);
+    return enqueue_wait(tid, rid, mode, entry, nullptr, deadline, lock);
+}
+
+LockResult LockManager::wait_for_conversion(int tid, ResourceId rid, LockMode mode, LockEntry& entry, Deadline deadline,
+                                            std::unique_lock<std::mutex>& lock) {
+    trace<TraceLevel::INFO>("Transaction {} waiting to upgrade to {} lock on resource {}", tid, mode_name(mode), rid);
+    LockRequest* before = entry.wait_queue.front();
+    while (before && before->conversion) before = before->next;
+    // two readers upgrading the same resource wait for each other and show up as a cycle
+    return enqueue_wait(tid, rid, mode, entry, before, deadline, lock);
+}
+
+static Deadline deadline_after(std::chrono::steady_clock::duration timeout) {
+    auto now = std::chrono::steady_clock::now();
+    return timeout >= Deadline::max() - now ? Deadline::max() : now + timeout;
+}
+
+LockResult LockManager::enqueue_wait(int tid, ResourceId rid, LockMode mode, LockEntry& entry, LockRequest* before,
+                                     Deadline deadline, std::unique_lock<std::mutex>& lock) {
+    // every path returns with the entry mutex held
+    bool async = static_cast<bool>(transactions[tid].resume);
+    if (deadline == DEFAULT_DEADLINE) {
+        auto timeout = transactions[tid].lock_timeout;
+        deadline = timeout == NOWAIT ? Deadline{} : deadline_after(timeout);
+    }
+    transactions[tid].blocked_until = deadline;
+    if (deadline != Deadline::max() && deadline <= std::chrono::steady_clock::now()) {
+        trace<TraceLevel::ERROR>("Transaction {} may not wait for {} lock on resource {}, timing out",
+                    tid, mode_name(mode), rid);
+        metrics->count(Counter::TIMEOUTS);
+        return LockResult::TIMEOUT;
+    }
+
+    LockRequest& req = transactions[tid].request;
+    req.mode = mode;
+    req.tid = tid;
+    req.conversion = entry.holders.count(tid) != 0;
+    if (deadlock_options.policy == DeadlockPolicy::DETECT) {
+        entry.wait_queue.insert(before, req);
+        transactions[tid].waiting_on = &entry;
+        if (add_wait_edges(tid, entry) && resolve_deadlock(tid, lock)) {
+            return LockResult::DEADLOCK_VICTIM;
+        }
+    } else {
+        bool wounded = false;
+        if (!apply_wait_policy(tid, entry, before, wounded)) {
+            trace<TraceLevel::ERROR>("Transaction {} may not wait for {} lock on resource {}, aborting",
+                        tid, mode_name(mode), rid);
+            return LockResult::DEADLOCK_VICTIM;
+        }
+        entry.wait_queue.insert(before, req);
+        transactions[tid].waiting_on = &entry;
+        if (wounded) {
+            lock.unlock();
+            wake_pending_victims();
+            lock.lock();
+        }
+    }
+    if (async) {
+        // an asynchronous request does not wait here, see acquire_pinned
+        metrics->count(Counter::WAITS);
+        metrics->contended(rid);
+        return LockResult::PENDING;
+    }
+    return await_grant(tid, rid, mode, entry, deadline, lock);
+}
+
+bool LockManager::apply_wait_policy(int tid, LockEntry& entry, LockRequest* before, bool& wounded) {
+    // We may end up waiting for any holder, since holders can convert and jump the queue,
+    // and for every request in front of us. Checking that whole set once at enqueue time
+    // keeps every wait pointing from older to younger (wait-die) or younger to older
+    // (wound-wait), so no cycle can form. Returns false if the requester has to abort.
+    std::uint64_t ts = transactions[tid].stats.timestamp;
+    std::vector<int> blockers;
+    for (const auto& [holder, held_mode] : entry.holders) {
+        if (holder != tid) blockers.push_back(holder);
+    }
+    for (LockRequest* req = entry.wait_queue.front(); req != before; req = req->next) {
+        blockers.push_back(req->tid);
+    }
+
+    switch (deadlock_options.policy) {
+        case DeadlockPolicy::NO_WAIT:
+            return false;
+        case DeadlockPolicy::WAIT_DIE:
+            return std::none_of(blockers.begin(), blockers.end(),
+                                [this, ts](int b) { return transactions[b].stats.timestamp < ts; });
+        case DeadlockPolicy::WOUND_WAIT: {
+            std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
+            for (int b : blockers) {
+                if (transactions[b].stats.timestamp > ts && !transactions[b].abort_requested.exchange(true)) {
+                    trace<TraceLevel::ERROR>("Transaction {} wounds younger transaction {}", tid, b);
+                    pending_wakeups.push_back(b);
+                    wounded = true;
+                }
             }
+            return true;
         }
+        case DeadlockPolicy::DETECT:
+            break;
     }
+    return true;
+}
 
-    auto& g = graph[tid];
-    auto it = find(g.begin(), g.end(), rid);
-    if(it != g.end()) {
-        g.erase(it);
+LockResult LockManager::await_grant(int tid, ResourceId rid, LockMode mode, LockEntry& entry, Deadline deadline,
+                                    std::unique_lock<std::mutex>& lock) {
+    // grant_waiters() moves the request into the holder set on our behalf
+    auto granted = [&entry, tid, mode]() {
+        auto it = entry.holders.find(tid);
+        return it != entry.holders.end() && it->second == mode;
+    };
+    auto woken = [this, &granted, tid]() { return granted() || transactions[tid].abort_requested; };
+    auto start = std::chrono::steady_clock::now();
+    metrics->count(Counter::WAITS);
+    metrics->contended(rid);
+
+    // under DETECT a long wait runs deadlock detection once, unless the deadline comes
+    // first; the prevention policies never let a cycle form
+    Deadline detect_at = deadline_after(DETECTION_TIMEOUT);
+    bool detection_pending = deadlock_options.policy == DeadlockPolicy::DETECT && detect_at < deadline;
+    while (detection_pending || deadline != Deadline::max()) {
+        Deadline until = detection_pending ? detect_at : deadline;
+        if (transactions[tid].wakeup.wait_until(lock, until, woken)) break;
+        if (!detection_pending) {
+            trace<TraceLevel::ERROR>("Timeout for transaction {} waiting for {} lock on {}", tid, mode_name(mode), rid);
+            metrics->count(Counter::TIMEOUTS);
+            return LockResult::TIMEOUT;
+        }
+        detection_pending = false;
+        trace<TraceLevel::ERROR>("Transaction {} waited {}s for {} lock on {}, checking for deadlock",
+                    tid, DETECTION_TIMEOUT.count(), mode_name(mode), rid);
+        lock.unlock();
+        if (canIRunDeadlockDetection(tid) && detect_deadlock(tid)) {
+            transactions[tid].abort_requested = true;
+            metrics->count(Counter::DEADLOCKS);
+        }
+        lock.lock();
     }
-    if(!deadlock_detected) return 0;
-    return -1;
-}   
+    transactions[tid].wakeup.wait(lock, woken);
 
-void LockManager::read_lock(int tid, int rid) {
-    if (transaction_phase[tid] == Phase::SHRINKING) {
-        std::println("Transaction {} in shrinking phase, locking violates 2PL protocol.", tid);
-        abort_transaction(tid);
+    LockResult result = wait_outcome(tid, mode, entry);
+    if (result == LockResult::GRANTED) {
+        metrics->wait_time(static_cast<std::size_t>(mode), std::chrono::steady_clock::now() - start);
     }
+    return result;
+}
 
-    std::unique_lock<std::mutex> lock(mtx[rid]);
+LockResult LockManager::wait_outcome(int tid, LockMode mode, LockEntry& entry) {
+    // with the entry mutex held, once a waiter has been granted or asked to abort
+    auto it = entry.holders.find(tid);
+    if (it == entry.holders.end() || it->second != mode) {
+        trace<TraceLevel::ERROR>("Transaction {} chosen as deadlock victim", tid);
+        return LockResult::DEADLOCK_VICTIM;
+    }
+    if (deadlock_options.policy == DeadlockPolicy::WOUND_WAIT && transactions[tid].abort_requested) {
+        // a wound stands even if the grant came first
+        trace<TraceLevel::ERROR>("Transaction {} was wounded by an older transaction", tid);
+        return LockResult::DEADLOCK_VICTIM;
+    }
+    transactions[tid].abort_requested = false;   // granted before the victim request took effect
+    return LockResult::GRANTED;
+}
 
-    if (state[rid] == LockState::WRITE_GRANTED || !wait_queue[rid].empty()) {
-        std::println("Transaction {} waiting for read lock on resource {}", tid, rid);
-        wait_queue[rid].push({ReqType::READ_REQ, tid});
-        graph[tid].push_back(rid);
+void LockManager::cancel_request(int tid, ResourceId rid, LockEntry& entry) {
+    // called when a waiter is aborted, the request may have been granted meanwhile
+    std::unique_lock<std::mutex> lock(entry.mtx);
+    if (transactions[tid].request.queued) {
+        entry.wait_queue.erase(transactions[tid].request);
+        transactions[tid].waiting_on = nullptr;
+    } else if (!transactions[tid].locks.find(rid)) {
+        entry.revoke(tid);
+    }
+    clear_wait_edges(tid);
+    grant_waiters(rid, entry);
+    entry.deflate_if_idle();
+    lock.unlock();
+    wake_pending_victims();
+}
 
-        auto wait_result = cv[rid].wait_for(lock, std::chrono::seconds(TIMEOUT), 
-            [this, rid, tid]() { 
-                return state[rid] != LockState::WRITE_GRANTED && wait_queue[rid].front().second == tid; 
-            });
+void LockManager::grant_waiters(ResourceId rid, LockEntry& entry) {
+    // pending conversions sit at the head of the queue, so they are served first;
+    // then every compatible request at the head is granted in one pass
+    std::vector<int> granted;
+    while (!entry.wait_queue.empty()) {
+        LockRequest& req = *entry.wait_queue.front();
+        if (req.conversion && entry.holders.count(req.tid) == 0) {
+            entry.wait_queue.erase(req);   // converter released everything while aborting
+            transactions[req.tid].waiting_on = nullptr;
+            continue;
+        }
+        if (!entry.grantable(req.mode, req.tid)) break;
 
-        if (!wait_result) {
-            std::println("Timeout for transaction {} waiting for read lock on {}", tid, rid);
-            if(canIRunDeadlockDetection(tid)) deadlock_detection(tid);
-            cv[rid].wait(lock, [this, rid, tid]() {
-                return state[rid] != LockState::WRITE_GRANTED && wait_queue[rid].front().second == tid;
-            });
+        entry.wait_queue.erase(req);
+        transactions[req.tid].waiting_on = nullptr;
+        entry.grant(req.tid, req.mode);
+        if (req.conversion) {
+            trace<TraceLevel::INFO>("Granting upgrade to {} lock on resource {} to transaction {}",
+                            mode_name(req.mode), rid, req.tid);
+        } else {
+            trace<TraceLevel::INFO>("Granting {} lock on resource {} to waiting transaction {}",
+                            mode_name(req.mode), rid, req.tid);
         }
+        granted.push_back(req.tid);
+    }
 
-        wait_queue[rid].pop();
+    if (!granted.empty() || !entry.wait_queue.empty()) {
+        refresh_wait_edges(rid, entry, granted);
     }
-    auto it = find(graph[tid].begin(), graph[tid].end(), rid);
-    if(it != graph[tid].end()) {
-        graph[tid].erase(it);
+    // only the granted requests are woken, everyone else keeps sleeping
+    for (int t : granted) {
+        notify_waiter(t);
     }
-    state[rid] = LockState::READ_GRANTED;
-    locks_held[tid].insert(rid);
-    std::println("Transaction {} acquired read lock on resource {}", tid, rid);
 }
 
-void LockManager::write_lock(int tid, int rid) {
-    if (transaction_phase[tid] == Phase::SHRINKING) {
-        std::println("Transaction {} in shrinking phase, locking violates 2PL protocol.", tid);
-        abort_transaction(tid);
+LockResult LockManager::admit(int tid) {
+    // a transaction may request locks only while growing and not wounded
+    if (transactions[tid].phase == Phase::SHRINKING) {
+        trace<TraceLevel::ERROR>("Transaction {} in shrinking phase, locking violates 2PL protocol.", tid);
+        rollback(tid, AbortCause::PROTOCOL_VIOLATION);
+        return LockResult::PROTOCOL_VIOLATION;
+    }
+    if (deadlock_options.policy == DeadlockPolicy::WOUND_WAIT && transactions[tid].abort_requested) {
+        trace<TraceLevel::ERROR>("Transaction {} was wounded by an older transaction", tid);
+        rollback(tid, AbortCause::DEADLOCK);
+        return LockResult::DEADLOCK_VICTIM;
     }
+    return LockResult::GRANTED;
+}
 
-    std::unique_lock<std::mutex> lock(mtx[rid]);
+LockResult LockManager::acquire(int tid, ResourceId rid, LockMode mode) {
+    return acquire(tid, rid, mode, DEFAULT_DEADLINE);
+}
 
-    if (state[rid] != LockState::UNLOCKED || !wait_queue[rid].empty()) {
-        std::println("Transaction {} waiting for write lock on resource {}", tid, rid);
-        wait_queue[rid].push({ReqType::WRITE_REQ, tid});
-        graph[tid].push_back(rid);
+LockResult LockManager::acquire(int tid, ResourceId rid, LockMode mode, std::chrono::steady_clock::duration timeout) {
+    return acquire(tid, rid, mode, timeout == NOWAIT ? Deadline{} : deadline_after(timeout));
+}
 
-        auto wait_result = cv[rid].wait_for(lock, std::chrono::seconds(TIMEOUT), 
-            [this, rid, tid]() { 
-                return state[rid] == LockState::UNLOCKED && wait_queue[rid].front().second == tid; 
-            });
+LockResult LockManager::acquire(int tid, ResourceId rid, LockMode mode, Deadline deadline) {
+    LockResult admitted = admit(tid);
+    if (admitted != LockResult::GRANTED) return admitted;
+
+    LockList::Item* held = transactions[tid].locks.find_item(rid);
+    if (held && supremum(held->mode, mode) == held->mode) {
+        return LockResult::GRANTED;   // the mode we hold already includes the request
+    }
+    return acquire_pinned(tid, rid, mode, held ? *held->entry : pin_entry(rid), deadline);
+}
 
-        if (!wait_result) {
-            std::println("Timeout for transaction {} waiting for write lock on {}", tid, rid);
-            if(canIRunDeadlockDetection(tid)) deadlock_detection(tid);
-            cv[rid].wait(lock, [this, rid, tid]() {
-                return state[rid] == LockState::UNLOCKED && wait_queue[rid].front().second == tid;
+LockResult LockManager::acquire_pinned(int tid, ResourceId rid, LockMode mode, LockEntry& entry, Deadline deadline,
+                                       AsyncRequest* async) {
+    // the caller pinned the entry for a new request; a conversion uses the holder's pin
+    LockMode* held = transactions[tid].locks.find(rid);
+    bool newly_held = held == nullptr;
+    LockMode target = newly_held ? mode : supremum(*held, mode);
+    if (recorder) recorder->record(LockEventKind::REQUEST, tid, rid, mode);
+
+    if (newly_held ? entry.try_thin(0, LockEntry::thin(tid, target))
+                   : entry.try_thin(LockEntry::thin(tid, *held), LockEntry::thin(tid, target))) {
+        if (recorder) recorder->record(LockEventKind::GRANT, tid, rid, target);
+        transactions[tid].locks.set(rid, target, &entry);
+        count_held(tid, newly_held);
+        transactions[tid].stats.locks_acquired++;
+        metrics->count(Counter::GRANTS);
+        trace<TraceLevel::INFO>("Transaction {} acquired {} lock on resource {}", tid, mode_name(target), rid);
+        return LockResult::GRANTED;
+    }
+
+    std::unique_lock<std::mutex> lock(entry.mtx);
+    entry.inflate();
+    bool must_wait;
+    if (newly_held) {
+        must_wait = !entry.wait_queue.empty() || !entry.grantable(target, tid);
+    } else {
+        // convert in place instead of queueing behind our own lock
+        bool conversion_pending = !entry.wait_queue.empty() && entry.wait_queue.front()->conversion;
+        must_wait = conversion_pending || !entry.grantable(target, tid);
+    }
+    if (!must_wait) {
+        entry.grant(tid, target);
+        return finish_acquire(tid, rid, target, newly_held, entry, LockResult::GRANTED, lock);
+    }
+
+    if (async) {
+        // run the rest of this call on the executor once the request is granted or aborted
+        auto start = std::chrono::steady_clock::now();
+        transactions[tid].resume = [this, tid, rid, target, newly_held, &entry, start, async = std::move(*async)] {
+            async.executor([this, tid, rid, target, newly_held, &entry, start, done = async.done] {
+                std::unique_lock<std::mutex> lock(entry.mtx);
+                LockResult result = wait_outcome(tid, target, entry);
+                if (result == LockResult::GRANTED) {
+                    metrics->wait_time(static_cast<std::size_t>(target), std::chrono::steady_clock::now() - start);
+                }
+                done(finish_acquire(tid, rid, target, newly_held, entry, result, lock));
             });
+        };
+    }
+    LockResult result = newly_held ? wait_for_grant(tid, rid, target, entry, deadline, lock)
+                                   : wait_for_conversion(tid, rid, target, entry, deadline, lock);
+    if (async) {
+        // a grant or victim wakeup that already ran resume owns the outcome now
+        if (result == LockResult::PENDING || !transactions[tid].resume) return LockResult::PENDING;
+        transactions[tid].resume = nullptr;
+    }
+    return finish_acquire(tid, rid, target, newly_held, entry, result, lock);
+}
+
+LockResult LockManager::finish_acquire(int tid, ResourceId rid, LockMode target, bool newly_held, LockEntry& entry,
+                                       LockResult result, std::unique_lock<std::mutex>& lock) {
+    if (result != LockResult::GRANTED) {
+        // withdraw the request before releasing everything else, so nobody grants it meanwhile
+        lock.unlock();
+        cancel_request(tid, rid, entry);
+        if (newly_held) entry.unpin();
+        rollback(tid, result == LockResult::TIMEOUT ? AbortCause::TIMEOUT : AbortCause::DEADLOCK);
+        return result;
+    }
+
+    if (recorder) recorder->record(LockEventKind::GRANT, tid, rid, target);
+    transactions[tid].locks.set(rid, target, &entry);
+    count_held(tid, newly_held);
+    transactions[tid].stats.locks_acquired++;
+    metrics->count(Counter::GRANTS);
+    trace<TraceLevel::INFO>("Transaction {} acquired {} lock on resource {}", tid, mode_name(target), rid);
+    lock.unlock();
+    return LockResult::GRANTED;
+}
+
+LockResult LockManager::acquire_async(int tid, ResourceId rid, LockMode mode, Executor executor,
+                                      std::function<void(LockResult)> done) {
+    LockResult admitted = admit(tid);
+    if (admitted != LockResult::GRANTED) return admitted;
+
+    LockList::Item* held = transactions[tid].locks.find_item(rid);
+    if (held && supremum(held->mode, mode) == held->mode) {
+        return LockResult::GRANTED;
+    }
+    AsyncRequest async{std::move(executor), std::move(done)};
+    return acquire_pinned(tid, rid, mode, held ? *held->entry : pin_entry(rid), DEFAULT_DEADLINE, &async);
+}
+
+void LockManager::lock(int tid, ResourceId rid, LockMode mode) {
+    if (acquire(tid, rid, mode) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::read_lock(int tid, ResourceId rid) {
+    lock(tid, rid, LockMode::S);
+}
+
+void LockManager::write_lock(int tid, ResourceId rid) {
+    lock(tid, rid, LockMode::X);
+}
+
+LockResult LockManager::release(int tid, ResourceId rid) {
+    trace<TraceLevel::DEBUG>("Transaction {} requesting to unlock resource {}", tid, rid);
+
+    const LockList::Item* item = transactions[tid].locks.erase(rid);
+    if (!item) {
+        rollback(tid, AbortCause::PROTOCOL_VIOLATION);
+        return LockResult::PROTOCOL_VIOLATION;
+    }
+    count_held(tid, -1);
+    if (recorder) recorder->record(LockEventKind::RELEASE, tid, rid);
+    release_held(tid, *item);
+    return LockResult::GRANTED;
+}
+
+void LockManager::release_held(int tid, const LockList::Item& item) {
+    transactions[tid].phase = Phase::SHRINKING;
+    release_entry(tid, item);
+    item.entry->unpin();
+    wake_pending_victims();
+}
+
+void LockManager::release_entry(int tid, const LockList::Item& item) {
+    // the entry stays pinned by this transaction, the caller unpins it
+    ResourceId rid = item.rid;
+    LockEntry& entry = *item.entry;
+
+    if (entry.try_thin(LockEntry::thin(tid, item.mode), 0)) {
+        trace<TraceLevel::INFO>("Transaction {} released lock on resource {}", tid, rid);
+        return;
+    }
+    std::unique_lock lock(entry.mtx);
+    trace<TraceLevel::DEBUG>("Transaction {} has locked resource {}", tid, rid);
+    entry.inflate();
+
+    // other shared holders keep the resource locked until the last one leaves
+    entry.revoke(tid);
+    trace<TraceLevel::INFO>("Transaction {} released lock on resource {}", tid, rid);
+
+    grant_waiters(rid, entry);
+    entry.deflate_if_idle();
+}
+
+void LockManager::unlock(int tid, ResourceId rid) {
+    if (release(tid, rid) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+LockResult LockManager::acquire_many(int tid, std::span<const LockSpec> requests) {
+    // Every caller takes the same (partition, rid) order, so two transactions that
+    // declare their lock sets up front can never wait for each other in a cycle.
+    LockResult admitted = admit(tid);
+    if (admitted != LockResult::GRANTED) return admitted;
+    // one deadline covers the whole batch, set by the first request that waits
+    Deadline deadline = DEFAULT_DEADLINE;
+    transactions[tid].blocked_until = DEFAULT_DEADLINE;
+
+    std::vector<LockSpec> sorted(requests.begin(), requests.end());
+    std::sort(sorted.begin(), sorted.end(), [this](const LockSpec& a, const LockSpec& b) {
+        std::size_t pa = partition_index(a.rid), pb = partition_index(b.rid);
+        return pa != pb ? pa < pb : a.rid < b.rid;
+    });
+    std::size_t n = 0;
+    for (const LockSpec& req : sorted) {
+        if (n > 0 && sorted[n - 1].rid == req.rid) {
+            sorted[n - 1].mode = supremum(sorted[n - 1].mode, req.mode);
+        } else {
+            sorted[n++] = req;
         }
+    }
+    sorted.resize(n);
 
-        wait_queue[rid].pop();
+    std::vector<LockEntry*> entries(n);
+    std::vector<bool> pinned(n);
+    for (std::size_t first = 0; first < n; ) {
+        std::size_t p = partition_index(sorted[first].rid);
+        std::size_t group_end = first;
+        {
+            // One latch round trip pins the whole group and grants its free entries
+            // as thin locks. Only up to the first entry that needs more than that: a
+            // lock past it could be what another batch waits for while holding it.
+            std::unique_lock<std::mutex> latch(partitions[p].latch);
+            bool in_order = true;
+            for (; group_end < n && partition_index(sorted[group_end].rid) == p; group_end++) {
+                const LockSpec& req = sorted[group_end];
+                LockList::Item* held = transactions[tid].locks.find_item(req.rid);
+                if (held && supremum(held->mode, req.mode) == held->mode) continue;
+                // conversions use the holder's pin, only new requests are pinned here
+                pinned[group_end] = !held;
+                LockEntry& entry = held ? *held->entry : pin_locked(partitions[p], req.rid);
+                in_order = in_order && !held && entry.try_thin(0, LockEntry::thin(tid, req.mode));
+                if (!in_order) {
+                    entries[group_end] = &entry;
+                    continue;
+                }
+                if (recorder) {
+                    recorder->record(LockEventKind::REQUEST, tid, req.rid, req.mode);
+                    recorder->record(LockEventKind::GRANT, tid, req.rid, req.mode);
+                }
+                transactions[tid].locks.set(req.rid, req.mode, &entry);
+                count_held(tid, 1);
+                transactions[tid].stats.locks_acquired++;
+                metrics->count(Counter::GRANTS);
+                trace<TraceLevel::INFO>("Transaction {} acquired {} lock on resource {}", tid, mode_name(req.mode), req.rid);
+            }
+        }
+        for (std::size_t i = first; i < group_end; i++) {
+            if (!entries[i]) continue;
+            LockResult result = acquire_pinned(tid, sorted[i].rid, sorted[i].mode, *entries[i], deadline);
+            if (deadline == DEFAULT_DEADLINE) deadline = transactions[tid].blocked_until;
+            if (result != LockResult::GRANTED) {
+                for (std::size_t j = i + 1; j < group_end; j++) {
+                    if (entries[j] && pinned[j]) entries[j]->unpin();
+                }
+                return result;
+            }
+        }
+        first = group_end;
+    }
+    return LockResult::GRANTED;
+}
+
+void LockManager::set_lock_timeout(int tid, std::chrono::steady_clock::duration timeout) {
+    transactions[tid].lock_timeout = timeout;
+}
+
+LockResult LockManager::release_many(int tid, std::span<const ResourceId> rids) {
+    for (ResourceId rid : rids) {
+        if (!transactions[tid].locks.find(rid)) {
+            trace<TraceLevel::ERROR>("Transaction {} does not hold a lock on resource {} to unlock", tid, rid);
+            rollback(tid, AbortCause::PROTOCOL_VIOLATION);
+            return LockResult::PROTOCOL_VIOLATION;
+        }
     }
 
-    state[rid] = LockState::WRITE_GRANTED;
-    locks_held[tid].insert(rid);
-    auto it = find(graph[tid].begin(), graph[tid].end(), rid);
-    if(it != graph[tid].end()) {
-        graph[tid].erase(it);
+    transactions[tid].phase = Phase::SHRINKING;
+    std::vector<LockList::Item> items;
+    for (ResourceId rid : rids) {
+        if (const LockList::Item* item = transactions[tid].locks.erase(rid)) {
+            if (recorder) recorder->record(LockEventKind::RELEASE, tid, rid);
+            items.push_back(*item);
+            items.back().live = true;
+            count_held(tid, -1);
+        }
     }
-    std::println("Transaction {} acquired write lock on resource {}", tid, rid);
+    std::sort(items.begin(), items.end(), [this](const LockList::Item& a, const LockList::Item& b) {
+        return release_before(a, b);
+    });
+    release_batch(tid, items.begin(), items.end());
+    return LockResult::GRANTED;
 }
 
-void LockManager::unlock(int tid, int rid) {
-    std::println("Transaction {} requesting to unlock resource {}", tid, rid);
-    std::unique_lock lock(mtx[rid]);
-    std::println("Transaction {} has locked resource {}", tid, rid);
+void LockManager::lock_many(int tid, std::span<const LockSpec> requests) {
+    if (acquire_many(tid, requests) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
 
-    if (locks_held[tid].find(rid) == locks_held[tid].end()) {
+void LockManager::unlock_many(int tid, std::span<const ResourceId> rids) {
+    if (release_many(tid, rids) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::upgrade_lock(int tid, ResourceId rid) {
+    if (!transactions[tid].locks.find(rid)) {
+        trace<TraceLevel::ERROR>("Transaction {} does not hold a lock on resource {} to upgrade", tid, rid);
+        abort_transaction(tid);
+    }
+    lock(tid, rid, LockMode::X);
+}
+
+void LockManager::downgrade_lock(int tid, ResourceId rid) {
+    LockList::Item* held = transactions[tid].locks.find_item(rid);
+    if (!held) {
+        trace<TraceLevel::ERROR>("Transaction {} does not hold a lock on resource {} to downgrade", tid, rid);
         abort_transaction(tid);
     }
+    if (held->mode != LockMode::X && held->mode != LockMode::SIX) return;
 
-    transaction_phase[tid] = Phase::SHRINKING;
-    locks_held[tid].erase(rid);
+    LockEntry& entry = *held->entry;
+    std::unique_lock lock(entry.mtx);
+    entry.inflate();
 
-    auto& g = graph[tid];
-    auto it = find(g.begin(), g.end(), rid);
-    if(it != g.end()) {
-        g.erase(it);
+    // giving up exclusivity releases a lock mode, so 2PL forbids new locks afterwards
+    transactions[tid].phase = Phase::SHRINKING;
+    held->mode = LockMode::S;
+    entry.grant(tid, LockMode::S);
+    if (recorder) recorder->record(LockEventKind::GRANT, tid, rid, LockMode::S, EVENT_DOWNGRADE);
+    trace<TraceLevel::INFO>("Transaction {} downgraded to read lock on resource {}", tid, rid);
+    grant_waiters(rid, entry);
+    lock.unlock();
+    wake_pending_victims();
+}
+
+static bool covers_descendants(LockMode held, LockMode mode) {
+    // S and SIX imply S on every descendant, X implies everything
+    return held == LockMode::X ||
+           ((held == LockMode::S || held == LockMode::SIX) && (mode == LockMode::S || mode == LockMode::IS));
+}
+
+LockResult LockManager::acquire_hierarchy(int tid, ResourceId rid, LockMode mode) {
+    if (granularity(rid) == Granularity::FLAT) {
+        return acquire(tid, rid, mode);
     }
 
-    state[rid] = LockState::UNLOCKED;
-    std::println("Transaction {} released lock on resource {}", tid, rid);
+    ResourceId path[3];
+    int depth = 0;
+    for (ResourceId r = rid; ; r = parent_resource(r)) {
+        path[depth++] = r;
+        if (granularity(r) == Granularity::TABLE) break;
+    }
 
-    if (!wait_queue[rid].empty()) {
-        auto [req_type, waiting_tid] = wait_queue[rid].front();
-        state[rid] = (req_type == ReqType::READ_REQ) ?
-                        LockState::READ_GRANTED : LockState::UNLOCKED;
-        std::println("Granting {} lock on resource {} to waiting transaction {}",
-                        (req_type == ReqType::READ_REQ ? "read" : "write"), rid, waiting_tid);
-        cv[rid].notify_all();
+    LockMode intention = (mode == LockMode::S || mode == LockMode::IS) ? LockMode::IS : LockMode::IX;
+    for (int i = depth - 1; i > 0; i--) {
+        LockMode* held = transactions[tid].locks.find(path[i]);
+        if (held && covers_descendants(*held, mode)) {
+            return LockResult::GRANTED;   // implicitly locked through the ancestor
+        }
+        LockResult result = acquire(tid, path[i], intention);
+        if (result != LockResult::GRANTED) return result;
     }
+    LockResult result = acquire(tid, rid, mode);
+    if (result == LockResult::GRANTED) maybe_escalate(tid, rid);
+    return result;
 }
 
-int LockManager::canIRunDeadlockDetection(int tid){
-    std::unique_lock<std::mutex> lock(deadlock_mtx);
-    std::println("Transaction {} is checking if it can run deadlock detection", tid);
-    std::vector<bool> visited(N, false), rec_stack(N, false);
-
-    for (int i = 0; i < N; i++) {
-        if (!visited[i]) {
-            std::vector<int> cycle;
-            if (dfs(i, visited, rec_stack, cycle)) {
-                int to_abort = *std::max_element(cycle.begin(), cycle.end());
-                if(to_abort == tid){
-                    return 1;
+void LockManager::count_held(int tid, std::int64_t delta) {
+    transactions[tid].stats.locks_held += static_cast<std::uint32_t>(delta);
+    if (escalation.budget) locks_in_use.fetch_add(delta, std::memory_order_relaxed);
+}
+
+void LockManager::maybe_escalate(int tid, ResourceId rid) {
+    std::uint32_t held = transactions[tid].stats.locks_held;
+    bool over_threshold = escalation.threshold && held > escalation.threshold;
+    bool over_budget = escalation.budget && locks_in_use.load(std::memory_order_relaxed) > static_cast<std::int64_t>(escalation.budget);
+    if ((over_threshold || over_budget) && held >= transactions[tid].escalate_at) {
+        escalate(tid, table_of(rid));
+    }
+}
+
+void LockManager::escalate(int tid, ResourceId table) {
+    // Trade every page and row lock the transaction holds below table for one S or X
+    // lock on the table. This never waits: if the table lock is not free right now the
+    // fine locks stay, and the next attempt comes after the lock count has doubled.
+    LockList& locks = transactions[tid].locks;
+    bool exclusive = false;
+    std::size_t fine = 0;
+    for (const LockList::Item& item : locks) {
+        if (!item.live || granularity(item.rid) < Granularity::PAGE || table_of(item.rid) != table) continue;
+        fine++;
+        exclusive |= item.mode == LockMode::IX || item.mode == LockMode::SIX || item.mode == LockMode::X;
+    }
+    LockMode mode = exclusive ? LockMode::X : LockMode::S;
+    if (fine == 0) {
+        transactions[tid].escalate_at = transactions[tid].stats.locks_held * 2;
+        return;
+    }
+    if (try_acquire(tid, table, mode, nullptr) != LockResult::GRANTED) {
+        trace<TraceLevel::DEBUG>("Transaction {} could not escalate to {} lock on table resource {}",
+                    tid, mode_name(mode), table);
+        transactions[tid].escalate_at = transactions[tid].stats.locks_held * 2;
+        return;
+    }
+
+    // releasing locks that the table lock now covers keeps the transaction growing
+    std::vector<LockList::Item> items;
+    locks.extract([table](const LockList::Item& item) {
+        return granularity(item.rid) >= Granularity::PAGE && table_of(item.rid) == table;
+    }, items);
+    count_held(tid, -static_cast<std::int64_t>(items.size()));
+    if (recorder) {
+        for (const LockList::Item& item : items) recorder->record(LockEventKind::RELEASE, tid, item.rid);
+    }
+    std::sort(items.begin(), items.end(), [this](const LockList::Item& a, const LockList::Item& b) {
+        return release_before(a, b);
+    });
+    release_batch(tid, items.begin(), items.end());
+    metrics->count(Counter::ESCALATIONS);
+    trace<TraceLevel::INFO>("Transaction {} escalated {} locks to {} lock on table resource {}",
+                tid, items.size(), mode_name(mode), table);
+}
+
+void LockManager::lock_hierarchy(int tid, ResourceId rid, LockMode mode) {
+    if (acquire_hierarchy(tid, rid, mode) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::lock_table(int tid, std::uint32_t table, LockMode mode) {
+    lock_hierarchy(tid, table_resource(table), mode);
+}
+
+void LockManager::lock_page(int tid, std::uint32_t table, std::uint32_t page, LockMode mode) {
+    lock_hierarchy(tid, page_resource(table, page), mode);
+}
+
+void LockManager::lock_row(int tid, std::uint32_t table, std::uint32_t page, std::uint32_t slot, LockMode mode) {
+    lock_hierarchy(tid, row_resource(table, page, slot), mode);
+}
+
+LockResult LockManager::acquire_range(int tid, ResourceId low, ResourceId high, LockMode mode) {
+    return acquire_range(tid, low, high, mode, DEFAULT_DEADLINE);
+}
+
+LockResult LockManager::acquire_range(int tid, ResourceId low, ResourceId high, LockMode mode, Deadline deadline) {
+    LockResult admitted = admit(tid);
+    if (admitted != LockResult::GRANTED) return admitted;
+    if (low > high) {
+        trace<TraceLevel::ERROR>("Transaction {} asked for the empty key range [{}, {}]", tid, low, high);
+        rollback(tid, AbortCause::PROTOCOL_VIOLATION);
+        return LockResult::PROTOCOL_VIOLATION;
+    }
+
+    std::unique_lock<std::mutex> lock(range_mtx);
+    std::vector<int> blockers;
+    range_blockers(tid, low, high, mode, blockers);
+    if (!blockers.empty()) {
+        LockResult result = wait_for_range(tid, low, high, mode, deadline, std::move(blockers), lock);
+        if (result != LockResult::GRANTED) {
+            lock.unlock();
+            rollback(tid, result == LockResult::TIMEOUT ? AbortCause::TIMEOUT : AbortCause::DEADLOCK);
+            return result;
+        }
+    }
+    std::uint64_t id = range_table.insert(low, high, {tid, mode});
+    lock.unlock();
+
+    transactions[tid].ranges.push_back({low, high, mode, id});
+    count_held(tid, 1);
+    transactions[tid].stats.locks_acquired++;
+    metrics->count(Counter::GRANTS);
+    trace<TraceLevel::INFO>("Transaction {} acquired {} lock on key range [{}, {}]", tid, mode_name(mode), low, high);
+    return LockResult::GRANTED;
+}
+
+void LockManager::range_blockers(int tid, ResourceId low, ResourceId high, LockMode mode, std::vector<int>& blockers) {
+    // with range_mtx held: other transactions' incompatible ranges overlapping ours, granted
+    // or queued ahead of us, since a waiting range is not overtaken by a later one
+    range_table.overlapping(low, high, [&](ResourceId, ResourceId, const RangeOwner& owner) {
+        if (owner.tid != tid && !compatible(mode, owner.mode)) blockers.push_back(owner.tid);
+    });
+    for (const RangeRequest& req : range_waiters) {
+        if (req.tid == tid) break;
+        if (req.low <= high && low <= req.high && !compatible(mode, req.mode)) blockers.push_back(req.tid);
+    }
+    std::sort(blockers.begin(), blockers.end());
+    blockers.erase(std::unique(blockers.begin(), blockers.end()), blockers.end());
+}
+
+LockResult LockManager::wait_for_range(int tid, ResourceId low, ResourceId high, LockMode mode, Deadline deadline,
+                                       std::vector<int> blockers, std::unique_lock<std::mutex>& lock) {
+    // every path returns with range_mtx held and the request out of the queue
+    Transaction& txn = transactions[tid];
+    if (deadline == DEFAULT_DEADLINE) {
+        deadline = txn.lock_timeout == NOWAIT ? Deadline{} : deadline_after(txn.lock_timeout);
+    }
+    if (deadline != Deadline::max() && deadline <= std::chrono::steady_clock::now()) {
+        trace<TraceLevel::ERROR>("Transaction {} may not wait for {} lock on key range [{}, {}], timing out",
+                    tid, mode_name(mode), low, high);
+        metrics->count(Counter::TIMEOUTS);
+        return LockResult::TIMEOUT;
+    }
+
+    // the prevention policies judge the blockers once, as apply_wait_policy does
+    std::uint64_t ts = txn.stats.timestamp;
+    bool may_wait = true;
+    switch (deadlock_options.policy) {
+        case DeadlockPolicy::NO_WAIT:
+            may_wait = false;
+            break;
+        case DeadlockPolicy::WAIT_DIE:
+            may_wait = std::none_of(blockers.begin(), blockers.end(),
+                                    [this, ts](int b) { return transactions[b].stats.timestamp < ts; });
+            break;
+        case DeadlockPolicy::WOUND_WAIT: {
+            std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
+            for (int b : blockers) {
+                if (transactions[b].stats.timestamp > ts && !transactions[b].abort_requested.exchange(true)) {
+                    trace<TraceLevel::ERROR>("Transaction {} wounds younger transaction {}", tid, b);
+                    pending_wakeups.push_back(b);
                 }
             }
+            break;
         }
+        case DeadlockPolicy::DETECT:
+            break;
     }
-    return 0;
+    if (!may_wait) {
+        trace<TraceLevel::ERROR>("Transaction {} may not wait for {} lock on key range [{}, {}], aborting",
+                    tid, mode_name(mode), low, high);
+        return LockResult::DEADLOCK_VICTIM;
+    }
+
+    trace<TraceLevel::INFO>("Transaction {} waiting for {} lock on key range [{}, {}]", tid, mode_name(mode), low, high);
+    range_waiters.push_back({tid, low, high, mode});
+    txn.range_wait = true;
+    metrics->count(Counter::WAITS);
+    metrics->contended(low);
+    auto start = std::chrono::steady_clock::now();
+
+    LockResult result = LockResult::GRANTED;
+    bool edges_changed = true;
+    for (;;) {
+        if (edges_changed && deadlock_options.policy == DeadlockPolicy::DETECT) {
+            // in BACKGROUND mode the detector thread finds the cycle in the graph
+            std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
+            waits_for[tid] = blockers;
+            if (deadlock_options.mode == DetectionMode::ON_WAIT) break_cycles(tid, tid);
+        }
+        // victims, ours or the wounded, are woken without range_mtx, which waking may need
+        lock.unlock();
+        wake_pending_victims();
+        lock.lock();
+        // recheck before sleeping too, a release while range_mtx was dropped notified nobody
+        std::vector<int> now_blocking;
+        auto changed = [&] {
+            if (txn.abort_requested) return true;
+            now_blocking.clear();
+            range_blockers(tid, low, high, mode, now_blocking);
+            return now_blocking.empty() || now_blocking != blockers;
+        };
+        bool woken = true;
+        if (deadline == Deadline::max()) {
+            txn.wakeup.wait(lock, changed);
+        } else {
+            woken = txn.wakeup.wait_until(lock, deadline, changed);
+        }
+        if (txn.abort_requested) {
+            trace<TraceLevel::ERROR>("Transaction {} chosen as deadlock victim", tid);
+            result = LockResult::DEADLOCK_VICTIM;
+            break;
+        }
+        if (now_blocking.empty()) break;
+        if (!woken) {
+            trace<TraceLevel::ERROR>("Timeout for transaction {} waiting for {} lock on key range [{}, {}]",
+                        tid, mode_name(mode), low, high);
+            metrics->count(Counter::TIMEOUTS);
+            result = LockResult::TIMEOUT;
+            break;
+        }
+        edges_changed = true;
+        blockers = std::move(now_blocking);
+    }
+
+    std::erase_if(range_waiters, [tid](const RangeRequest& req) { return req.tid == tid; });
+    txn.range_wait = false;
+    clear_wait_edges(tid);
+    if (result == LockResult::GRANTED) {
+        // granted before a victim request took effect, except that a wound stands
+        if (deadlock_options.policy != DeadlockPolicy::WOUND_WAIT) txn.abort_requested = false;
+        metrics->wait_time(static_cast<std::size_t>(mode), std::chrono::steady_clock::now() - start);
+    } else {
+        notify_range_waiters();   // requests queued behind ours may go ahead now
+    }
+    return result;
 }
 
-void LockManager::deadlock_detection(int tid) {
-    std::println("Transaction {} performing deadlock detection", tid);
-    std::println("Printing graph edges:");
-    allocated_edges();
-    request_edges();
-    std::vector<bool> visited(N, false), rec_stack(N, false);
-    for (int i = 0; i < N; i++) {
-        if (!visited[i]) {
-            std::vector<int> cycle;
-            if (dfs(i, visited, rec_stack, cycle)) {
-                std::println("Deadlock detected involving transactions:");
-                for (int t : cycle) {
-                    std::println("  {}", t);
-                }
-                int to_abort = *std::max_element(cycle.begin(), cycle.end());
-                if(to_abort == tid){
-                    // abort transaction
-                    std::println("Aborting transaction {}", tid);
-                    std::vector<int> resources_to_release(locks_held[tid].begin(), locks_held[tid].end());
-                    for (int rid : resources_to_release) {
-                        unlock(tid, rid);
-                    }
-                    graph[tid].clear();
-                    transaction_phase[tid] = Phase::GROWING;
-                    throw std::runtime_error("abort_transaction");
-                }
-                return;
+void LockManager::notify_range_waiters() {
+    // with range_mtx held; every waiter rechecks its own range
+    for (const RangeRequest& req : range_waiters) {
+        metrics->count(Counter::WAKEUPS);
+        transactions[req.tid].wakeup.notify_one();
+    }
+}
+
+LockResult LockManager::release_range(int tid, ResourceId low, ResourceId high) {
+    std::vector<HeldRange>& ranges = transactions[tid].ranges;
+    auto held = std::find_if(ranges.begin(), ranges.end(),
+                             [low, high](const HeldRange& r) { return r.low == low && r.high == high; });
+    if (held == ranges.end()) {
+        trace<TraceLevel::ERROR>("Transaction {} does not hold a lock on key range [{}, {}]", tid, low, high);
+        rollback(tid, AbortCause::PROTOCOL_VIOLATION);
+        return LockResult::PROTOCOL_VIOLATION;
+    }
+    transactions[tid].phase = Phase::SHRINKING;
+    {
+        std::unique_lock<std::mutex> lock(range_mtx);
+        range_table.erase(held->low, held->id);
+        notify_range_waiters();
+    }
+    ranges.erase(held);
+    count_held(tid, -1);
+    trace<TraceLevel::INFO>("Transaction {} released lock on key range [{}, {}]", tid, low, high);
+    wake_pending_victims();
+    return LockResult::GRANTED;
+}
+
+void LockManager::release_ranges(int tid) {
+    // the caller resets the lock count
+    std::vector<HeldRange>& ranges = transactions[tid].ranges;
+    {
+        std::unique_lock<std::mutex> lock(range_mtx);
+        for (const HeldRange& r : ranges) {
+            range_table.erase(r.low, r.id);
+            trace<TraceLevel::INFO>("Transaction {} released lock on key range [{}, {}]", tid, r.low, r.high);
+        }
+        notify_range_waiters();
+    }
+    ranges.clear();
+}
+
+void LockManager::lock_range(int tid, ResourceId low, ResourceId high, LockMode mode) {
+    if (acquire_range(tid, low, high, mode) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::lock_key(int tid, ResourceId key, LockMode mode) {
+    lock_range(tid, key, key, mode);
+}
+
+void LockManager::unlock_range(int tid, ResourceId low, ResourceId high) {
+    if (release_range(tid, low, high) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void LockManager::wait_edges(const LockEntry& entry, const LockRequest& req, std::vector<int>& edges) {
+    // a queued request waits for the incompatible holders and, because grants are FIFO,
+    // for the request right in front of it
+    edges.clear();
+    for (const auto& [holder, held_mode] : entry.holders) {
+        if (holder != req.tid && !compatible(req.mode, held_mode)) edges.push_back(holder);
+    }
+    if (req.prev && req.prev->tid != req.tid) {
+        edges.push_back(req.prev->tid);
+    }
+}
+
+bool LockManager::add_wait_edges(int tid, LockEntry& entry) {
+    if (deadlock_options.policy != DeadlockPolicy::DETECT) return false;
+    std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
+    const LockRequest& req = transactions[tid].request;
+    wait_edges(entry, req, waits_for[tid]);
+    bool eager = deadlock_options.mode == DetectionMode::ON_WAIT;
+    bool found = eager && break_cycles(tid, tid);
+
+    // a conversion jumps the queue, so the request behind it now waits for us as well
+    if (req.next) {
+        int next = req.next->tid;
+        wait_edges(entry, *req.next, waits_for[next]);
+        found |= eager && break_cycles(next, tid);
+    }
+    return found;
+}
+
+void LockManager::refresh_wait_edges(ResourceId rid, LockEntry& entry, const std::vector<int>& granted) {
+    // holders changed, so every remaining waiter of this entry gets its edges recomputed.
+    // Edges to freshly granted transactions cannot close a cycle, but a request leaving
+    // the middle of the queue hands its successor a new edge to a waiting transaction.
+    if (deadlock_options.policy != DeadlockPolicy::DETECT) return;
+    std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
+    for (int t : granted) {
+        waits_for[t].clear();
+    }
+    std::vector<int> changed, edges;
+    for (const LockRequest* req = entry.wait_queue.front(); req; req = req->next) {
+        int t = req->tid;
+        wait_edges(entry, *req, edges);
+        for (int u : edges) {
+            if (!waits_for[u].empty() &&
+                std::find(waits_for[t].begin(), waits_for[t].end(), u) == waits_for[t].end()) {
+                changed.push_back(t);
+                break;
             }
         }
+        waits_for[t].swap(edges);
     }
 
-    std::println("No deadlock detected by transaction {}", tid);
+    if (deadlock_options.mode != DetectionMode::ON_WAIT) return;
+    for (int t : changed) {
+        break_cycles(t, -1);
+    }
 }
 
-bool LockManager::dfs(int v, std::vector<bool>& visited, std::vector<bool>& rec_stack, std::vector<int>& cycle) {
-    if (!visited[v]) {
-        visited[v] = true;
-        rec_stack[v] = true;
+void LockManager::clear_wait_edges(int tid) {
+    if (deadlock_options.policy != DeadlockPolicy::DETECT) return;
+    std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
+    waits_for[tid].clear();
+}
+
+bool LockManager::find_cycle(int tid, std::vector<int>& cycle) {
+    // iterative DFS over the part of the graph reachable from tid, skipping
+    // transactions that are already being aborted; caller holds deadlock_mtx
+    if (++epoch == 0) {
+        std::fill(visit_epoch.begin(), visit_epoch.end(), 0);
+        epoch = 1;
+    }
+    std::vector<std::pair<int, std::size_t>> stack{{tid, 0}};
+    visit_epoch[tid] = epoch;
+    while (!stack.empty()) {
+        auto& [v, next] = stack.back();
+        if (next == waits_for[v].size()) {
+            stack.pop_back();
+            continue;
+        }
+        int u = waits_for[v][next++];
+        if (u == tid) {
+            for (const auto& frame : stack) {
+                cycle.push_back(frame.first);
+            }
+            return true;
+        }
+        if (visit_epoch[u] == epoch || transactions[u].abort_requested) continue;
+        visit_epoch[u] = epoch;
+        stack.push_back({u, 0});
+    }
+    return false;
+}
+
+bool LockManager::break_cycles(int tid, int requester) {
+    // new edges out of tid may close several cycles at once, pick a victim for each
+    // until none is left; victims other than the requester are woken later by
+    // wake_pending_victims(). Caller holds deadlock_mtx.
+    bool found = false;
+    std::vector<int> cycle;
+    while (!transactions[tid].abort_requested && find_cycle(tid, cycle)) {
+        trace<TraceLevel::INFO>("Deadlock detected involving transactions:");
+        for (int t : cycle) {
+            trace<TraceLevel::INFO>("  {}", t);
+        }
+        int victim = choose_victim(cycle);
+        transactions[victim].abort_requested = true;
+        metrics->count(Counter::DEADLOCKS);
+        if (victim != requester) {
+            trace<TraceLevel::ERROR>("Transaction {} chosen as deadlock victim, waking it up", victim);
+            pending_wakeups.push_back(victim);
+        }
+        cycle.clear();
+        found = true;
+    }
+    return found;
+}
+
+bool LockManager::resolve_deadlock(int tid, std::unique_lock<std::mutex>& lock) {
+    // wake the victims chosen for us, returns true if we are one of them
+    lock.unlock();
+    wake_pending_victims();
+    lock.lock();
+    if (transactions[tid].abort_requested) {
+        trace<TraceLevel::ERROR>("Transaction {} chosen as deadlock victim", tid);
+        return true;
+    }
+    return false;
+}
 
-        for (const auto& x : graph[v]) {
-                int rid = x;
-                for (int i = 0; i < N; ++i) {
-                    if (i != v && locks_held[i].find(rid) != locks_held[i].end()) {
-                        if (!visited[i] && dfs(i, visited, rec_stack, cycle)) {
-                            cycle.push_back(i);
-                            return true;
-                        } else if (rec_stack[i]) {
-                            cycle.push_back(i);
-                            return true;
-                        }
+void LockManager::wake_transaction(int tid) {
+    // notify under the mutex of the entry or range table it waits on, so a waiter
+    // between its predicate check and its wait cannot miss the abort request
+    {
+        std::unique_lock<std::mutex> lock(range_mtx);
+        if (transactions[tid].range_wait) {
+            metrics->count(Counter::WAKEUPS);
+            transactions[tid].wakeup.notify_one();
+            return;
+        }
+    }
+    // A victim that is not queued, such as a wounded holder still running, sees the
+    // abort request on its next call. Entries are never freed, only reused, so the
+    // one read here is safe to lock even if the victim has left it since.
+    LockEntry* entry = transactions[tid].waiting_on;
+    if (!entry) return;
+    std::unique_lock<std::mutex> lock(entry->mtx);
+    if (transactions[tid].waiting_on == entry) notify_waiter(tid);
+}
+
+void LockManager::notify_waiter(int tid) {
+    // with the entry mutex held; an asynchronous waiter is resumed exactly once
+    metrics->count(Counter::WAKEUPS);
+    if (transactions[tid].resume) {
+        auto resume = std::move(transactions[tid].resume);
+        transactions[tid].resume = nullptr;
+        resume();
+    } else {
+        transactions[tid].wakeup.notify_one();
+    }
+}
+
+void LockManager::wake_pending_victims() {
+    std::vector<int> wakeups;
+    {
+        std::unique_lock<std::mutex> dl_lock(deadlock_mtx);
+        if (pending_wakeups.empty()) return;
+        wakeups.swap(pending_wakeups);
+    }
+    for (int victim : wakeups) {
+        wake_transaction(victim);
+    }
+}
+
+int LockManager::canIRunDeadlockDetection(int tid){
+    std::unique_lock<std::mutex> lock(deadlock_mtx);
+    trace<TraceLevel::DEBUG>("Transaction {} is checking if it can run deadlock detection", tid);
+    std::vector<int> cycle;
+    return find_cycle(tid, cycle) && choose_victim(cycle) == tid;
+}
+
+void LockManager::deadlock_detection(int tid) {
+    if (detect_deadlock(tid)) {
+        abort_transaction(tid);
+    }
+}
+
+bool LockManager::detect_deadlock(int tid) {
+    if constexpr (TRACE_LEVEL >= TraceLevel::DEBUG) {
+        trace<TraceLevel::DEBUG>("Transaction {} performing deadlock detection", tid);
+        trace<TraceLevel::DEBUG>("Printing graph edges:");
+        allocated_edges();
+        request_edges();
+    }
+
+    std::vector<int> cycle;
+    {
+        std::unique_lock<std::mutex> lock(deadlock_mtx);
+        if (!find_cycle(tid, cycle)) {
+            trace<TraceLevel::DEBUG>("No deadlock detected by transaction {}", tid);
+            return false;
+        }
+    }
+    trace<TraceLevel::INFO>("Deadlock detected involving transactions:");
+    for (int t : cycle) {
+        trace<TraceLevel::INFO>("  {}", t);
+    }
+    return choose_victim(cycle) == tid;
+}
+
+int LockManager::choose_victim(const std::vector<int>& cycle) {
+    // ties go to the highest tid so every thread picks the same victim
+    std::vector<VictimCandidate> candidates;
+    for (int t : cycle) {
+        auto started = std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(transactions[t].stats.started.load()));
+        candidates.push_back({t, started, transactions[t].stats.timestamp.load(), transactions[t].stats.locks_held.load(),
+                              transactions[t].stats.locks_acquired.load()});
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const VictimCandidate& a, const VictimCandidate& b) { return a.tid > b.tid; });
+
+    if (deadlock_options.choose_victim) {
+        int victim = deadlock_options.choose_victim(candidates);
+        if (std::find(cycle.begin(), cycle.end(), victim) != cycle.end()) return victim;
+        trace<TraceLevel::ERROR>("Victim policy picked transaction {} which is not on the cycle", victim);
+        return candidates.front().tid;
+    }
+
+    auto best = candidates.begin();
+    for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+        switch (deadlock_options.victim_policy) {
+            case VictimPolicy::HIGHEST_TID:  break;
+            case VictimPolicy::YOUNGEST:     if (it->timestamp > best->timestamp) best = it; break;
+            case VictimPolicy::FEWEST_LOCKS: if (it->locks_held < best->locks_held) best = it; break;
+            case VictimPolicy::LEAST_WORK:   if (it->locks_acquired < best->locks_acquired) best = it; break;
+        }
+    }
+    return best->tid;
+}
+
+void LockManager::run_detector(std::stop_token stop) {
+    std::mutex sleep_mtx;
+    std::condition_variable_any sleep_cv;
+    std::unique_lock<std::mutex> sleep_lock(sleep_mtx);
+    while (!stop.stop_requested()) {
+        sleep_cv.wait_for(sleep_lock, stop, deadlock_options.interval, [] { return false; });
+        if (stop.stop_requested()) break;
+        detect_deadlocks();
+    }
+}
+
+int LockManager::detect_deadlocks() {
+    // copy the graph so lock requests are not held up while we search it
+    std::vector<std::vector<int>> graph(num_transactions);
+    bool any_waiter = false;
+    {
+        std::unique_lock<std::mutex> lock(deadlock_mtx);
+        for (int t = 0; t < num_transactions; t++) {
+            if (!waits_for[t].empty() && !transactions[t].abort_requested) {
+                graph[t] = waits_for[t];
+                any_waiter = true;
+            }
+        }
+    }
+    if (!any_waiter) return 0;
+
+    // colour DFS over the snapshot; after each cycle the victim is dropped and the
+    // scan restarts, deadlocks are rare enough for that to be cheap
+    std::vector<std::pair<std::vector<int>, int>> cycles;   // cycle and its victim
+    std::vector<char> state(num_transactions);          // 0 unvisited, 1 on stack, 2 done
+    std::vector<std::pair<int, std::size_t>> stack;
+    bool restart = true;
+    while (restart) {
+        restart = false;
+        std::fill(state.begin(), state.end(), 0);
+        for (int s = 0; s < num_transactions && !restart; s++) {
+            if (state[s] != 0 || graph[s].empty()) continue;
+            stack.assign(1, {s, 0});
+            state[s] = 1;
+            while (!stack.empty()) {
+                auto& [v, next] = stack.back();
+                if (next == graph[v].size()) {
+                    state[v] = 2;
+                    stack.pop_back();
+                    continue;
+                }
+                int u = graph[v][next++];
+                if (state[u] == 0 && !graph[u].empty()) {
+                    state[u] = 1;
+                    stack.push_back({u, 0});
+                } else if (state[u] == 1) {
+                    std::vector<int> cycle;
+                    auto from = std::find_if(stack.begin(), stack.end(),
+                                             [u](const auto& frame) { return frame.first == u; });
+                    for (auto it = from; it != stack.end(); ++it) {
+                        cycle.push_back(it->first);
                     }
+                    int victim = choose_victim(cycle);
+                    graph[victim].clear();
+                    cycles.push_back({std::move(cycle), victim});
+                    restart = true;
+                    break;
                 }
-            
+            }
         }
     }
-    rec_stack[v] = false;
-    return false;
+
+    // a cycle in a consistent snapshot is still there unless one of its members
+    // was aborted meanwhile, so only that needs checking before picking the victim
+    int victims = 0;
+    {
+        std::unique_lock<std::mutex> lock(deadlock_mtx);
+        for (const auto& [cycle, victim] : cycles) {
+            bool intact = true;
+            for (std::size_t i = 0; i < cycle.size(); i++) {
+                const auto& edges = waits_for[cycle[i]];
+                int next = cycle[(i + 1) % cycle.size()];
+                intact &= !transactions[cycle[i]].abort_requested &&
+                          std::find(edges.begin(), edges.end(), next) != edges.end();
+            }
+            if (!intact) continue;
+
+            trace<TraceLevel::INFO>("Deadlock detected involving transactions:");
+            for (int t : cycle) {
+                trace<TraceLevel::INFO>("  {}", t);
+            }
+            trace<TraceLevel::ERROR>("Transaction {} chosen as deadlock victim, waking it up", victim);
+            transactions[victim].abort_requested = true;
+            pending_wakeups.push_back(victim);
+            metrics->count(Counter::DEADLOCKS);
+            victims++;
+        }
+    }
+    wake_pending_victims();
+    return victims;
+}
+
+LockStats LockManager::snapshot_stats() const {
+    return metrics->snapshot();
+}
+
+void LockManager::set_recorder(LockRecorder* recorder) {
+    this->recorder = recorder;
 }
 
 void LockManager::allocated_edges(){
-    std::println("Allocated edges:");
-    for (int i = 0; i < N; ++i) {
-            if(locks_held[i].size()){
-            std::println("  Transaction {}: ", i);
-            for (const auto& rid : locks_held[i]) {
-                std::println("      Resource {}", rid);
+    // read from the lock table under its latches and entry mutexes; a transaction's own
+    // lock list belongs to the thread running it and may be reallocated meanwhile
+    trace<TraceLevel::DEBUG>("Allocated edges:");
+    for (std::size_t i = 0; i <= partition_mask; i++) {
+        std::unique_lock<std::mutex> latch(partitions[i].latch);
+        for (const auto& [rid, entry] : partitions[i].table) {
+            std::unique_lock<std::mutex> lock(entry->mtx);
+            std::uint64_t state = entry->state.load(std::memory_order_acquire);
+            if (state != 0 && state != LockEntry::INFLATED) {
+                trace<TraceLevel::DEBUG>("  Transaction {} holds resource {} ({})", static_cast<int>((state & 0xFFFFFFFFu) - 1),
+                            rid, mode_name(static_cast<LockMode>(state >> 32)));
+                continue;
+            }
+            for (const auto& [holder, mode] : entry->holders) {
+                trace<TraceLevel::DEBUG>("  Transaction {} holds resource {} ({})", holder, rid, mode_name(mode));
             }
         }
     }
-    std::println();
+    trace<TraceLevel::DEBUG>("");
 }
 
 void LockManager::request_edges(){
-    std::println("Request edges:");
-    for (int i = 0; i < N; ++i) {
-        if(graph[i].size()){
-            std::println("  Transaction {}: ", i);
-            for (const auto& rid : graph[i]) {
-                std::println("      Resource {}", rid);
+    std::unique_lock<std::mutex> lock(deadlock_mtx);
+    trace<TraceLevel::DEBUG>("Request edges:");
+    for (int i = 0; i < num_transactions; ++i) {
+        if(waits_for[i].size()){
+            trace<TraceLevel::DEBUG>("  Transaction {}: ", i);
+            if (const LockEntry* entry = transactions[i].waiting_on) {
+                trace<TraceLevel::DEBUG>("      Resource {}", entry->rid.load());
+            }
+            for (int t : waits_for[i]) {
+                trace<TraceLevel::DEBUG>("      Waits for transaction {}", t);
             }
         }
     }
-    std::println();
+    trace<TraceLevel::DEBUG>("");
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <cstdint>
 #include <future>
@@ -11,46 +13,686 @@
 #include <vector>
 #include <mutex>
 #include <condition_variable>
+#include <coroutine>
 #include <queue>
+#include <deque>
+#include <map>
+#include <new>
 #include <set>
 #include <stdexcept>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <span>
+#include <stop_token>
+#include "intervaltree.h"
+#include "metrics.h"
+#include "trace.h"
 
-#define N 10  // Number of transactions
-#define M 10  // Number of resources
-#define TIMEOUT 10  // Timeout in seconds
+// runs a task later on some thread, never inline in the call (think asio::post)
+using Executor = std::function<void(std::function<void()>)>;
+
+// a waiter blocked this long runs deadlock detection itself
+constexpr std::chrono::seconds DETECTION_TIMEOUT{10};
+
+// Lock wait limits, per request or as a transaction's default. A blocked request is
+// dequeued and fails with TIMEOUT once its deadline passes; NOWAIT fails it at once.
+// Like every other failed acquire, a TIMEOUT rolls the whole transaction back, since
+// a wait limit mostly ends waits that a deadlock would never end; use try_acquire to
+// probe a lock and keep the transaction.
+using Deadline = std::chrono::steady_clock::time_point;
+inline constexpr std::chrono::steady_clock::duration NO_TIMEOUT = std::chrono::steady_clock::duration::max();
+inline constexpr std::chrono::steady_clock::duration NOWAIT = std::chrono::steady_clock::duration::zero();
 
 enum class Phase { GROWING, SHRINKING };
-enum class LockState { READ_GRANTED, WRITE_GRANTED, UNLOCKED };
-enum class ReqType { READ_REQ, WRITE_REQ };
+enum class LockMode { IS, IX, S, SIX, X };
+static_assert(LockStats::MODES == 5, "one wait histogram per lock mode");
+
+// Compatibility and supremum of the multi-granularity lock modes, indexed by LockMode.
+inline constexpr bool LOCK_COMPATIBLE[5][5] = {
+    //            IS     IX     S      SIX    X
+    /* IS  */ {  true,  true,  true,  true,  false },
+    /* IX  */ {  true,  true,  false, false, false },
+    /* S   */ {  true,  false, true,  false, false },
+    /* SIX */ {  true,  false, false, false, false },
+    /* X   */ {  false, false, false, false, false },
+};
+
+inline constexpr LockMode LOCK_SUPREMUM[5][5] = {
+    { LockMode::IS,  LockMode::IX,  LockMode::S,   LockMode::SIX, LockMode::X },
+    { LockMode::IX,  LockMode::IX,  LockMode::SIX, LockMode::SIX, LockMode::X },
+    { LockMode::S,   LockMode::SIX, LockMode::S,   LockMode::SIX, LockMode::X },
+    { LockMode::SIX, LockMode::SIX, LockMode::SIX, LockMode::SIX, LockMode::X },
+    { LockMode::X,   LockMode::X,   LockMode::X,   LockMode::X,   LockMode::X },
+};
+
+inline constexpr bool compatible(LockMode a, LockMode b) {
+    return LOCK_COMPATIBLE[static_cast<int>(a)][static_cast<int>(b)];
+}
+
+inline constexpr LockMode supremum(LockMode a, LockMode b) {
+    return LOCK_SUPREMUM[static_cast<int>(a)][static_cast<int>(b)];
+}
+
+const char* mode_name(LockMode mode);
+
+// outcome of the status-returning lock calls
+enum class LockResult {
+    GRANTED,
+    WOULD_BLOCK,            // try_acquire only, nothing was queued
+    DEADLOCK_VICTIM,        // aborted to break or prevent a deadlock
+    TIMEOUT,                // the wait outlived its deadline
+    PROTOCOL_VIOLATION,     // locking after unlocking, or releasing a lock not held
+    PENDING,                // acquire_async only, the outcome arrives through its callback
+    VALIDATION_FAILED,      // OccManager only, something the transaction read has changed
+    OUT_OF_SPACE,           // SharedLockManager only, no room left in the shared lock table
+};
+
+const char* result_name(LockResult result);
+
+using ResourceId = std::uint64_t;
+
+// Resource ids carry their granularity in the top two bits. Level 0 is the flat
+// namespace used by read_lock/write_lock; tables, pages and rows form a hierarchy
+// where a lock on a parent implicitly covers its children.
+enum class Granularity { FLAT, TABLE, PAGE, ROW };
+
+inline constexpr int TABLE_BITS = 14, PAGE_BITS = 24, SLOT_BITS = 24;
+
+inline constexpr ResourceId table_resource(std::uint32_t table) {
+    return (ResourceId{1} << 62) | (ResourceId{table} << (PAGE_BITS + SLOT_BITS));
+}
+
+inline constexpr ResourceId page_resource(std::uint32_t table, std::uint32_t page) {
+    return (ResourceId{2} << 62) | (ResourceId{table} << (PAGE_BITS + SLOT_BITS)) | (ResourceId{page} << SLOT_BITS);
+}
+
+inline constexpr ResourceId row_resource(std::uint32_t table, std::uint32_t page, std::uint32_t slot) {
+    return (ResourceId{3} << 62) | (ResourceId{table} << (PAGE_BITS + SLOT_BITS)) |
+           (ResourceId{page} << SLOT_BITS) | ResourceId{slot};
+}
+
+inline constexpr Granularity granularity(ResourceId rid) {
+    return static_cast<Granularity>(rid >> 62);
+}
+
+// Table a page or row belongs to, or the table itself.
+inline constexpr ResourceId table_of(ResourceId rid) {
+    constexpr ResourceId body = (ResourceId{1} << 62) - 1;
+    return (ResourceId{1} << 62) | (rid & body & ~((ResourceId{1} << (PAGE_BITS + SLOT_BITS)) - 1));
+}
+
+// Parent in the hierarchy, only valid for pages and rows.
+inline constexpr ResourceId parent_resource(ResourceId rid) {
+    constexpr ResourceId body = (ResourceId{1} << 62) - 1;
+    if (granularity(rid) == Granularity::ROW) {
+        return (ResourceId{2} << 62) | (rid & body & ~((ResourceId{1} << SLOT_BITS) - 1));
+    }
+    return (ResourceId{1} << 62) | (rid & body & ~((ResourceId{1} << (PAGE_BITS + SLOT_BITS)) - 1));
+}
+
+// Structures written by different threads are padded to this, so neighbouring
+// entries, partitions and transaction slots never share a cache line.
+#ifdef __cpp_lib_hardware_interference_size
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"   // only used within this program, not an ABI
+#endif
+inline constexpr std::size_t CACHE_LINE = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else
+inline constexpr std::size_t CACHE_LINE = 64;
+#endif
+
+// A transaction waits for at most one lock at a time, so its request node lives in
+// its descriptor and queueing never allocates.
+struct LockRequest {
+    LockMode mode;
+    int tid;
+    bool conversion;                                    // holder strengthening its mode
+    bool queued = false;                                // linked into an entry's wait queue
+    LockRequest* prev = nullptr;
+    LockRequest* next = nullptr;
+};
+
+// Intrusive doubly-linked FIFO of request nodes, guarded by the entry mutex. Insertion
+// and removal anywhere are O(1), so an aborted waiter leaves without a search.
+class WaitQueue {
+public:
+    bool empty() const { return head == nullptr; }
+    LockRequest* front() const { return head; }
+    LockRequest* back() const { return tail; }
+
+    // before == nullptr appends
+    void insert(LockRequest* before, LockRequest& req);
+    void erase(LockRequest& req);
+
+private:
+    LockRequest* head = nullptr;
+    LockRequest* tail = nullptr;
+};
+
+// Lock state of a single resource. Entries are taken on the first request for a
+// resource and become idle once no transaction holds or waits for it.
+//
+// A resource held by at most one transaction is a thin lock: state holds the owner
+// and its mode, and acquire, convert and release are a single CAS without touching
+// mtx. The first request that cannot be served that way takes mtx and inflates the
+// entry, moving the owner into holders; from then on the holder map and wait queue
+// are authoritative until the entry is idle again and deflates.
+//
+// Holders and waiters pin the entry. Pins are atomic, so a transaction drops its pin
+// without the partition latch and a pin on a cached entry is taken without it too.
+// An entry is retired only under the latch, by swinging an unpinned count to RETIRED,
+// and is then reused for another resource rather than freed; a stale pointer to it
+// thus stays valid, and try_pin checks the resource again once the pin holds.
+//
+// The fields every request touches (state, pin count, mutex, queue head) come first
+// and the entry starts on its own cache line.
+struct alignas(CACHE_LINE) LockEntry {
+    static constexpr std::uint64_t INFLATED = 1ull << 63;
+    static constexpr int RETIRED = -1;
+
+    std::atomic<std::uint64_t> state{0};                // 0 free, thin(tid, mode) or INFLATED
+    std::atomic<int> pin_count{0};                      // holders + waiters, or RETIRED
+    std::atomic<ResourceId> rid{0};                     // resource served, set under the partition latch
+    std::mutex mtx;
+    WaitQueue wait_queue;                               // conversions first, then new requests
+    int granted[5] = {};                                // number of holders per mode
+    std::map<int, LockMode> holders;                    // granted tid -> mode
+
+    // true if mode can be granted next to every holder except tid
+    bool grantable(LockMode mode, int tid) const;
+    void grant(int tid, LockMode mode);
+    void revoke(int tid);
+
+    static constexpr std::uint64_t thin(int tid, LockMode mode) {
+        return static_cast<std::uint64_t>(tid + 1) | static_cast<std::uint64_t>(mode) << 32;
+    }
+    bool try_thin(std::uint64_t expected, std::uint64_t desired) {
+        return state.compare_exchange_strong(expected, desired, std::memory_order_acq_rel);
+    }
+    // pins the entry if it is live and serves resource, without the partition latch
+    bool try_pin(ResourceId resource);
+    // callers must not hold mtx, the entry may be reused for another resource here
+    void unpin() { pin_count.fetch_sub(1, std::memory_order_release); }
+    // both with mtx held
+    void inflate();
+    void deflate_if_idle();
+};
+
+// Locks held by one transaction, in acquisition order. The storage is kept from one
+// transaction to the next, so the steady state allocates nothing and clear() is O(1).
+// Lists longer than INDEX_THRESHOLD get an open-addressing index for lookups, whose
+// slots are invalidated by bumping a generation instead of being wiped.
+class LockList {
+public:
+    static constexpr std::size_t INDEX_THRESHOLD = 16;  // linear scan up to this many items
+
+    struct Item {
+        ResourceId rid;
+        LockMode mode;
+        bool live;                                      // false once released, skipped when walking
+        LockEntry* entry;                               // pinned by the holding transaction
+    };
+
+    LockList() { items.reserve(INDEX_THRESHOLD); }
+
+    LockMode* find(ResourceId rid);
+    Item* find_item(ResourceId rid) { return lookup(rid); }
+    void set(ResourceId rid, LockMode mode, LockEntry* entry);   // insert or change the mode
+    const Item* erase(ResourceId rid);                  // the tombstone stays readable until clear()
+    void clear();
+    std::size_t size() const { return count; }
+
+    // reorders the items, e.g. to release them grouped by partition
+    template <typename Compare>
+    void sort(Compare less) {
+        std::sort(items.begin(), items.end(), less);
+        if (indexed) rebuild_index();
+    }
+
+    // moves the live items matching pred to out and drops tombstones
+    template <typename Pred>
+    void extract(Pred pred, std::vector<Item>& out) {
+        std::size_t kept = 0;
+        for (Item& item : items) {
+            if (!item.live) continue;
+            if (pred(item)) {
+                out.push_back(item);
+            } else {
+                items[kept++] = item;
+            }
+        }
+        items.resize(kept);
+        count = kept;
+        if (indexed) rebuild_index();
+    }
+
+    auto begin() const { return items.begin(); }
+    auto end() const { return items.end(); }
+    auto rbegin() const { return items.rbegin(); }
+    auto rend() const { return items.rend(); }
+
+private:
+    struct Slot {
+        ResourceId rid;
+        std::uint32_t pos;
+        std::uint32_t generation;                       // slot is empty unless this matches
+    };
+
+    std::vector<Item> items;
+    std::vector<Slot> index;
+    std::uint32_t generation = 1;
+    bool indexed = false;
+    std::size_t count = 0;                              // live items
+
+    Item* lookup(ResourceId rid);
+    void index_insert(ResourceId rid, std::uint32_t pos);
+    void rebuild_index();
+};
+
+// one entry of a batched request
+struct LockSpec {
+    ResourceId rid;
+    LockMode mode;
+};
+
+// Idle entries (pin count 0) stay in the table until it has doubled since the last
+// sweep, which keeps up to MAX_IDLE of them and retires the rest to spare. A hot
+// resource thus keeps its entry, and recently pinned entries are published in hot, a
+// direct-mapped cache that pin_entry reads without the latch. Entries are owned by
+// the partition for the manager's lifetime, so one read from hot stays valid memory.
+struct alignas(CACHE_LINE) LockPartition {
+    static constexpr std::size_t MAX_IDLE = 32;
+    static constexpr std::size_t HOT_SLOTS = 64;
+
+    std::mutex latch;                                   // protects table, spare and sweep_at
+    std::unordered_map<ResourceId, LockEntry*> table;
+    std::vector<std::unique_ptr<LockEntry> > entries;   // every entry made for this partition
+    std::vector<LockEntry*> spare;                      // retired, reused for the next new resource
+    std::size_t sweep_at = MAX_IDLE;
+    std::atomic<LockEntry*> hot[HOT_SLOTS] = {};
+};
+
+enum class DetectionMode {
+    ON_WAIT,        // every blocked request searches for a cycle through itself
+    BACKGROUND,     // a detector thread scans a snapshot of the whole graph periodically
+};
+
+// DETECT lets transactions wait and breaks cycles in the waits-for graph; the others
+// never build the graph and decide from begin timestamps whether a conflict may wait
+enum class DeadlockPolicy {
+    DETECT,
+    WAIT_DIE,       // older requesters wait, younger ones abort
+    WOUND_WAIT,     // older requesters abort the younger blockers, younger ones wait
+    NO_WAIT,        // every conflict aborts the requester
+};
+
+// YOUNGEST goes by begin timestamp, which a restart after an abort keeps, so a victim
+// does not come back as the youngest and lose every cycle it joins
+enum class VictimPolicy { HIGHEST_TID, YOUNGEST, FEWEST_LOCKS, LEAST_WORK };
+
+// what a victim policy knows about each transaction on a cycle
+struct VictimCandidate {
+    int tid;
+    std::chrono::steady_clock::time_point started;      // latest begin, restarts included
+    std::uint64_t timestamp;                            // first begin, smaller is older
+    std::uint32_t locks_held;
+    std::uint64_t locks_acquired;                       // grants since begin, a proxy for work done
+};
+
+struct DeadlockOptions {
+    DeadlockPolicy policy = DeadlockPolicy::DETECT;
+    DetectionMode mode = DetectionMode::ON_WAIT;
+    std::chrono::milliseconds interval{5};              // BACKGROUND scan period
+    VictimPolicy victim_policy = VictimPolicy::HIGHEST_TID;
+    // overrides victim_policy when set, returns the tid to abort
+    std::function<int(const std::vector<VictimCandidate>&)> choose_victim;
+};
+
+// per-transaction counters read by the victim policy from other threads
+struct TxnStats {
+    std::atomic<std::chrono::steady_clock::rep> started{0};
+    std::atomic<std::uint32_t> locks_held{0};
+    std::atomic<std::uint64_t> locks_acquired{0};
+    std::atomic<std::uint64_t> timestamp{0};           // smaller is older, kept across restarts
+    bool restarted = false;                             // aborted, next begin reuses the timestamp
+};
+
+// A key-range lock held by a transaction, see LockManager::acquire_range.
+struct HeldRange {
+    ResourceId low, high;
+    LockMode mode;
+    std::uint64_t id;                                   // in the range table
+};
+
+// Everything one transaction slot owns, on its own cache lines so that threads
+// updating their phase or counters do not invalidate each other's.
+struct alignas(CACHE_LINE) Transaction {
+    Phase phase = Phase::GROWING;
+    LockList locks;
+    std::atomic<LockEntry*> waiting_on{nullptr};        // entry the transaction is queued on, set under its mutex
+    std::atomic<bool> abort_requested{false};           // deadlock victims chosen by another transaction
+    std::condition_variable wakeup;                     // a blocked transaction sleeps on it, with the entry mutex
+    LockRequest request;                                // queued while the transaction waits
+    std::function<void()> resume;                       // set while an asynchronous request waits
+    std::chrono::steady_clock::duration lock_timeout = NO_TIMEOUT;   // for requests without their own
+    Deadline blocked_until{};                           // deadline of the last request that waited
+    TxnStats stats;
+    std::uint32_t escalate_at = 0;                      // lock count before which escalation is not retried
+    std::vector<HeldRange> ranges;
+    bool range_wait = false;                            // blocked in the range table, guarded by range_mtx
+    std::atomic<std::uint64_t> id{0};                   // of the handle currently using the slot, 0 when free
+    std::atomic<int> next_free{-1};                     // free list link
+};
+
+// A transaction drawn from the descriptor pool. Ids are never reused, slots are, so a
+// handle kept past finish_transaction is recognised as stale: the lock calls taking a
+// handle check it first and refuse a stale one without touching the slot, which may
+// already belong to another transaction. Any thread may use a handle, one at a time.
+// The slot is only reachable by an explicit conversion, which skips that check.
+struct TxnHandle {
+    int slot = -1;
+    std::uint64_t id = 0;
+
+    constexpr explicit operator int() const { return slot; }
+};
+
+// Lock escalation, off when both limits are 0. A transaction holding more than
+// threshold locks, or any transaction while all of them together hold more than
+// budget, trades its page and row locks in the table it just locked for one table
+// lock. Only locks taken through lock_hierarchy and its helpers are escalated.
+struct EscalationOptions {
+    std::uint32_t threshold = 0;
+    std::size_t budget = 0;
+};
+
+class LockAwaiter;
+class LockRecorder;
 
 class LockManager {
 private:
-    std::mutex mtx[M];                     
-    LockState state[M];                            
-    std::queue<std::pair<ReqType, int> > wait_queue[M];    // req_type, tid 
-    std::vector<std::vector<int>> graph;       
-    std::condition_variable_any cv[M];            
-    std::vector<Phase> transaction_phase;         
-    std::vector<std::set<int>> locks_held;    
-    std::mutex deadlock_mtx;
+    int num_transactions;
+    std::unique_ptr<LockPartition[]> partitions;
+    std::size_t partition_mask;
+
+    // Descriptor pool. The free list is a Treiber stack whose head packs a version
+    // counter next to the slot, so a slot popped and pushed back in between cannot
+    // fool a stale compare-and-swap.
+    std::unique_ptr<Transaction[]> transactions;
+    std::atomic<std::uint64_t> free_head{0};            // version << 32 | (slot + 1), 0 slot part = empty
+    std::atomic<std::uint64_t> next_txn_id{0};
+
+    // waits-for graph, kept up to date as requests queue, get granted or leave
+    std::mutex deadlock_mtx;                            // guards the graph
+    std::vector<std::vector<int>> waits_for;            // tid -> transactions it waits for
+    std::vector<int> pending_wakeups;                   // victims to wake once no entry mutex is held
+    std::vector<std::uint32_t> visit_epoch;             // cycle search marks, reset by bumping epoch
+    std::uint32_t epoch = 0;
+
+    // Key-range locks. One interval table covers the whole ordered key space; waiters
+    // queue in arrival order and recheck their range whenever a range is released.
+    struct RangeOwner {
+        int tid;
+        LockMode mode;
+    };
+    struct RangeRequest {
+        int tid;
+        ResourceId low, high;
+        LockMode mode;
+    };
+    std::mutex range_mtx;                               // guards the range table and its waiters
+    IntervalTree<RangeOwner> range_table;
+    std::vector<RangeRequest> range_waiters;
+
+    DeadlockOptions deadlock_options;
+    EscalationOptions escalation;
+    std::atomic<std::int64_t> locks_in_use{0};          // held by all transactions, tracked for the budget only
+    std::atomic<std::uint64_t> next_timestamp{0};
+    std::unique_ptr<LockMetrics> metrics = std::make_unique<LockMetrics>();   // large, kept off the caller's stack
+    LockRecorder* recorder = nullptr;
+
+    void push_free(int tid);
+    int pop_free();
+
+    std::size_t partition_index(ResourceId rid) const;
+    bool release_before(const LockList::Item& a, const LockList::Item& b) const;
+    LockPartition& partition_of(ResourceId rid);
+    static std::size_t hot_slot(ResourceId rid);
+    LockEntry& pin_entry(ResourceId rid);
+    LockEntry& pin_locked(LockPartition& p, ResourceId rid);
+    void sweep(LockPartition& p);
+    LockResult try_acquire(int tid, ResourceId rid, LockMode mode, std::vector<int>* blockers);
+    // a request without its own deadline waits for the transaction's lock_timeout from when it blocks
+    static constexpr Deadline DEFAULT_DEADLINE = Deadline::min();
+
+    LockResult wait_for_grant(int tid, ResourceId rid, LockMode mode, LockEntry& entry, Deadline deadline,
+                              std::unique_lock<std::mutex>& lock);
+    LockResult wait_for_conversion(int tid, ResourceId rid, LockMode mode, LockEntry& entry, Deadline deadline,
+                                   std::unique_lock<std::mutex>& lock);
+    LockResult await_grant(int tid, ResourceId rid, LockMode mode, LockEntry& entry, Deadline deadline,
+                           std::unique_lock<std::mutex>& lock);
+    void cancel_request(int tid, ResourceId rid, LockEntry& entry);
+    void grant_waiters(ResourceId rid, LockEntry& entry);
+    bool apply_wait_policy(int tid, LockEntry& entry, LockRequest* before, bool& wounded);
+    LockResult enqueue_wait(int tid, ResourceId rid, LockMode mode, LockEntry& entry, LockRequest* before,
+                            Deadline deadline, std::unique_lock<std::mutex>& lock);
+    void rollback(int tid, AbortCause cause);
+    void count_held(int tid, std::int64_t delta);
+    void maybe_escalate(int tid, ResourceId rid);
+    void escalate(int tid, ResourceId table);
+    void release_all(int tid);
+    void release_held(int tid, const LockList::Item& item);
+    void release_entry(int tid, const LockList::Item& item);
+    template <typename It>
+    void release_batch(int tid, It first, It last);
+    LockResult admit(int tid);
+    bool check_handle(TxnHandle txn) const;
+    struct AsyncRequest {
+        Executor executor;
+        std::function<void(LockResult)> done;
+    };
+    LockResult acquire_pinned(int tid, ResourceId rid, LockMode mode, LockEntry& entry, Deadline deadline,
+                              AsyncRequest* async = nullptr);
+    LockResult finish_acquire(int tid, ResourceId rid, LockMode target, bool newly_held, LockEntry& entry,
+                              LockResult result, std::unique_lock<std::mutex>& lock);
+    LockResult wait_outcome(int tid, LockMode mode, LockEntry& entry);
+    void notify_waiter(int tid);
+    void range_blockers(int tid, ResourceId low, ResourceId high, LockMode mode, std::vector<int>& blockers);
+    LockResult wait_for_range(int tid, ResourceId low, ResourceId high, LockMode mode, Deadline deadline,
+                              std::vector<int> blockers, std::unique_lock<std::mutex>& lock);
+    void notify_range_waiters();
+    void release_ranges(int tid);
 
-    bool dfs(int v, std::vector<bool>& visited, std::vector<bool>& rec_stack, std::vector<int>& cycle);
+    void wait_edges(const LockEntry& entry, const LockRequest& req, std::vector<int>& edges);
+    bool add_wait_edges(int tid, LockEntry& entry);
+    void refresh_wait_edges(ResourceId rid, LockEntry& entry, const std::vector<int>& granted);
+    void clear_wait_edges(int tid);
+    bool find_cycle(int tid, std::vector<int>& cycle);
+    bool break_cycles(int tid, int requester);
+    bool resolve_deadlock(int tid, std::unique_lock<std::mutex>& lock);
+    bool detect_deadlock(int tid);
+    void wake_transaction(int tid);
+    void wake_pending_victims();
+    int choose_victim(const std::vector<int>& cycle);
+    void run_detector(std::stop_token stop);
+
+    std::jthread detector;                              // declared last so it stops before the rest is torn down
 
 public:
-    LockManager();
+    static constexpr int DEFAULT_TRANSACTIONS = 10;
+    static constexpr std::size_t DEFAULT_PARTITIONS = 64;
+
+    explicit LockManager(int num_transactions = DEFAULT_TRANSACTIONS,
+                         std::size_t num_partitions = DEFAULT_PARTITIONS,
+                         DeadlockOptions deadlock_options = {},
+                         EscalationOptions escalation = {});
+    ~LockManager();
     
-    void begin_transaction(int tid);
+    // lock_timeout is the default wait limit of the transaction's lock requests
+    void begin_transaction(int tid, std::chrono::steady_clock::duration lock_timeout = NO_TIMEOUT);
     void finish_transaction(int tid);
     void abort_transaction(int tid);
+
+    // Pooled transactions, for callers that do not manage tids themselves; do not mix
+    // with fixed tids on the same manager. Throws if every slot is in use. An aborted
+    // handle may begin again, keeping its age, and goes back to the pool once finished.
+    TxnHandle begin_transaction(std::chrono::steady_clock::duration lock_timeout = NO_TIMEOUT);
+    void begin_transaction(TxnHandle txn, std::chrono::steady_clock::duration lock_timeout = NO_TIMEOUT);
+    void finish_transaction(TxnHandle txn);
+    void abort_transaction(TxnHandle txn);
+    bool is_current(TxnHandle txn) const;
+
+    // the lock calls below for a pooled transaction; a stale handle gets
+    // PROTOCOL_VIOLATION, or the throwing wrappers' exception, and nothing is locked
+    LockResult acquire(TxnHandle txn, ResourceId rid, LockMode mode);
+    LockResult acquire(TxnHandle txn, ResourceId rid, LockMode mode, std::chrono::steady_clock::duration timeout);
+    LockResult acquire(TxnHandle txn, ResourceId rid, LockMode mode, Deadline deadline);
+    LockResult try_acquire(TxnHandle txn, ResourceId rid, LockMode mode);
+    LockResult acquire_hierarchy(TxnHandle txn, ResourceId rid, LockMode mode);
+    LockResult release(TxnHandle txn, ResourceId rid);
+    LockResult acquire_many(TxnHandle txn, std::span<const LockSpec> requests);
+    LockResult release_many(TxnHandle txn, std::span<const ResourceId> rids);
+    LockResult acquire_range(TxnHandle txn, ResourceId low, ResourceId high, LockMode mode);
+    LockResult release_range(TxnHandle txn, ResourceId low, ResourceId high);
+    LockResult acquire_async(TxnHandle txn, ResourceId rid, LockMode mode, Executor executor,
+                             std::function<void(LockResult)> done);
+    void set_lock_timeout(TxnHandle txn, std::chrono::steady_clock::duration timeout);
+    void lock(TxnHandle txn, ResourceId rid, LockMode mode);
+    void read_lock(TxnHandle txn, ResourceId rid);
+    void write_lock(TxnHandle txn, ResourceId rid);
+    void unlock(TxnHandle txn, ResourceId rid);
+    void lock_many(TxnHandle txn, std::span<const LockSpec> requests);
+    void unlock_many(TxnHandle txn, std::span<const ResourceId> rids);
+    void upgrade_lock(TxnHandle txn, ResourceId rid);
+    void downgrade_lock(TxnHandle txn, ResourceId rid);
+    void lock_hierarchy(TxnHandle txn, ResourceId rid, LockMode mode);
+    void lock_range(TxnHandle txn, ResourceId low, ResourceId high, LockMode mode);
+    void unlock_range(TxnHandle txn, ResourceId low, ResourceId high);
     
-    int try_lock(int tid, int rid, bool is_read_lock);
-    void read_lock(int tid, int rid);
-    void write_lock(int tid, int rid);
-    void unlock(int tid, int rid);
+    // Status-returning lock calls that never throw. Any result other than GRANTED from
+    // acquire, acquire_hierarchy or release means the transaction was rolled back and
+    // may begin again; try_acquire never waits and never aborts.
+    LockResult acquire(int tid, ResourceId rid, LockMode mode);
+    // the same with a wait limit for this request only
+    LockResult acquire(int tid, ResourceId rid, LockMode mode, std::chrono::steady_clock::duration timeout);
+    LockResult acquire(int tid, ResourceId rid, LockMode mode, Deadline deadline);
+    LockResult try_acquire(int tid, ResourceId rid, LockMode mode);
+    LockResult acquire_hierarchy(int tid, ResourceId rid, LockMode mode);
+    LockResult release(int tid, ResourceId rid);
+    // lock a whole read/write set in canonical order, pinning each partition's share
+    // of it under one latch round trip; release_many is the matching batched unlock.
+    // The lock_timeout runs from the first request that blocks and covers the rest.
+    LockResult acquire_many(int tid, std::span<const LockSpec> requests);
+    LockResult release_many(int tid, std::span<const ResourceId> rids);
+    void set_lock_timeout(int tid, std::chrono::steady_clock::duration timeout);
+
+    // Acquire without blocking the calling thread. When the request can be decided at
+    // once the result is returned and done is not called. Otherwise the request is
+    // queued, PENDING is returned, and once it is granted or the transaction is aborted
+    // done(result) runs through executor, with the same meaning as acquire's result.
+    // The transaction makes no other call until then. Asynchronous waits honour NOWAIT
+    // but no other timeout.
+    LockResult acquire_async(int tid, ResourceId rid, LockMode mode, Executor executor,
+                             std::function<void(LockResult)> done);
+    // co_await-able wrappers of acquire_async, resuming the coroutine on executor
+    LockAwaiter async_lock(int tid, ResourceId rid, LockMode mode, Executor executor);
+    LockAwaiter async_read_lock(int tid, ResourceId rid, Executor executor);
+    LockAwaiter async_write_lock(int tid, ResourceId rid, Executor executor);
+
+    // throwing wrappers, abort surfaces as std::runtime_error("abort_transaction")
+    int try_lock(int tid, ResourceId rid, bool is_read_lock);
+    int try_lock(int tid, ResourceId rid, LockMode mode);
+    void lock(int tid, ResourceId rid, LockMode mode);
+    void read_lock(int tid, ResourceId rid);
+    void write_lock(int tid, ResourceId rid);
+    void unlock(int tid, ResourceId rid);
+    void lock_many(int tid, std::span<const LockSpec> requests);
+    void unlock_many(int tid, std::span<const ResourceId> rids);
+    void upgrade_lock(int tid, ResourceId rid);
+    void downgrade_lock(int tid, ResourceId rid);
+
+    // take mode on the resource plus the matching intention locks on its ancestors,
+    // skipping anything already covered by a coarser lock the transaction holds
+    void lock_table(int tid, std::uint32_t table, LockMode mode);
+    void lock_page(int tid, std::uint32_t table, std::uint32_t page, LockMode mode);
+    void lock_row(int tid, std::uint32_t table, std::uint32_t page, std::uint32_t slot, LockMode mode);
+    void lock_hierarchy(int tid, ResourceId rid, LockMode mode);
+
+    // Key-range locks on ordered keys, a space of their own apart from rids. A lock
+    // on [low, high] conflicts only with incompatible locks of other transactions on
+    // overlapping ranges, so a scan that read-locks a range keeps writers from
+    // updating or inserting any key inside it, and a single key is the range
+    // [key, key]. Held until the transaction finishes unless released explicitly.
+    LockResult acquire_range(int tid, ResourceId low, ResourceId high, LockMode mode);
+    LockResult acquire_range(int tid, ResourceId low, ResourceId high, LockMode mode, Deadline deadline);
+    LockResult release_range(int tid, ResourceId low, ResourceId high);
+    void lock_range(int tid, ResourceId low, ResourceId high, LockMode mode);
+    void lock_key(int tid, ResourceId key, LockMode mode);
+    void unlock_range(int tid, ResourceId low, ResourceId high);
+
+    std::size_t live_entries();
     
     int canIRunDeadlockDetection(int tid);
     void deadlock_detection(int tid);
+    // one scan of the whole graph as run by the detector thread, returns the number of victims
+    int detect_deadlocks();
+
+    // counters, wait time histograms per mode and the most contended resources so far;
+    // cheap enough to scrape periodically while transactions run
+    LockStats snapshot_stats() const;
+
+    // Records begin, lock request, grant, denied try, downgrade, unlock, abort and
+    // finish events to recorder until set back to nullptr; change it only while no
+    // transaction is running. An escalation shows as a try request and grant on the
+    // table and an unlock of each lock it replaces. Key-range locks are not recorded.
+    void set_recorder(LockRecorder* recorder);
 
+    // trace the granted locks and the waits-for graph at DEBUG, safe while transactions run
     void allocated_edges();
     void request_edges();
-};
\ No newline at end of file
+};
+
+// co_await yields the LockResult; the coroutine continues inline when no wait was needed
+class LockAwaiter {
+public:
+    LockAwaiter(LockManager& lm, int tid, ResourceId rid, LockMode mode, Executor executor)
+        : lm(lm), tid(tid), rid(rid), mode(mode), executor(std::move(executor)) {}
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        LockResult status = lm.acquire_async(tid, rid, mode, std::move(executor), [this, handle](LockResult r) {
+            result = r;
+            handle.resume();
+        });
+        if (status == LockResult::PENDING) return true;   // this awaiter may be gone once the callback ran
+        result = status;
+        return false;
+    }
+
+    LockResult await_resume() const { return result; }
+
+private:
+    LockManager& lm;
+    int tid;
+    ResourceId rid;
+    LockMode mode;
+    Executor executor;
+    LockResult result = LockResult::PENDING;
+};
+
+inline LockAwaiter LockManager::async_lock(int tid, ResourceId rid, LockMode mode, Executor executor) {
+    return LockAwaiter(*this, tid, rid, mode, std::move(executor));
+}
+
+inline LockAwaiter LockManager::async_read_lock(int tid, ResourceId rid, Executor executor) {
+    return async_lock(tid, rid, LockMode::S, std::move(executor));
+}
+
+inline LockAwaiter LockManager::async_write_lock(int tid, ResourceId rid, Executor executor) {
+    return async_lock(tid, rid, LockMode::X, std::move(executor));
+}
@@ -0,0 +1,91 @@
+#include "lockrecorder.h"
+#include <cerrno>
+#include <format>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::uint64_t TRACE_MAGIC = 0x314352544B434F4Cull;    // "LOCKTRC1"
+constexpr std::uint32_t TRACE_VERSION = 1;
+
+}
+
+const char* event_name(LockEventKind kind) {
+    switch (kind) {
+        case LockEventKind::BEGIN:   return "begin";
+        case LockEventKind::REQUEST: return "request";
+        case LockEventKind::GRANT:   return "grant";
+        case LockEventKind::RELEASE: return "release";
+        case LockEventKind::ABORT:   return "abort";
+        case LockEventKind::FINISH:  return "finish";
+        case LockEventKind::DENY:    return "deny";
+    }
+    return "?";
+}
+
+LockRecorder::LockRecorder(const std::string& path, std::size_t capacity)
+    : path(path), size(sizeof(LockTraceHeader) + capacity * sizeof(LockEvent)) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), std::format("open {}", path));
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), std::format("ftruncate {}", path));
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) throw std::system_error(error, std::generic_category(), std::format("mmap {}", path));
+
+    header = new (mapping) LockTraceHeader{TRACE_MAGIC, TRACE_VERSION, sizeof(LockEvent), capacity, {0}, {0}, {}};
+    events = reinterpret_cast<LockEvent*>(static_cast<char*>(mapping) + sizeof(LockTraceHeader));
+    trace<TraceLevel::INFO>("Recording lock events to {}, room for {}", path, capacity);
+}
+
+LockRecorder::~LockRecorder() {
+    // keep only the records written, so the file is no larger than the trace
+    std::uint64_t written = recorded();
+    header->next.store(written, std::memory_order_relaxed);
+    msync(header, size, MS_SYNC);
+    munmap(header, size);
+    if (truncate(path.c_str(), static_cast<off_t>(sizeof(LockTraceHeader) + written * sizeof(LockEvent))) != 0) {
+        trace<TraceLevel::ERROR>("Could not truncate lock event trace {}", path);
+    }
+}
+
+std::uint64_t LockRecorder::recorded() const {
+    return std::min<std::uint64_t>(header->next.load(std::memory_order_relaxed), header->capacity);
+}
+
+LockTrace::LockTrace(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), std::format("open {}", path));
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(LockTraceHeader)) {
+        close(fd);
+        throw std::runtime_error(std::format("{} is not a lock event trace", path));
+    }
+    size = static_cast<std::size_t>(st.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) throw std::system_error(error, std::generic_category(), std::format("mmap {}", path));
+
+    header = static_cast<const LockTraceHeader*>(mapping);
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION || header->record_size != sizeof(LockEvent)) {
+        munmap(mapping, size);
+        throw std::runtime_error(std::format("{} is not a lock event trace", path));
+    }
+    // a recorder that did not shut down cleanly leaves the whole capacity behind
+    count = std::min<std::size_t>({header->next.load(std::memory_order_relaxed), header->capacity,
+                                   (size - sizeof(LockTraceHeader)) / sizeof(LockEvent)});
+    first = reinterpret_cast<const LockEvent*>(static_cast<const char*>(mapping) + sizeof(LockTraceHeader));
+}
+
+LockTrace::~LockTrace() {
+    munmap(const_cast<LockTraceHeader*>(header), size);
+}
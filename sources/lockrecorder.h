@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include "lockmanager.h"
+
+// Binary lock event traces, for profiling a lock manager offline. A LockRecorder
+// attached to a LockManager appends one fixed-size record per event to a file that it
+// maps into memory: recording is a fetch_add and a store, with no system call and no
+// formatting on the locking path. Events past the capacity are counted and dropped.
+// The file is cut to the records actually written when the recorder is destroyed.
+//
+// A LockTrace maps a finished file read-only for tools such as the bench03 replay.
+
+enum class LockEventKind : std::uint8_t {
+    BEGIN,
+    REQUEST,            // a lock call reached the lock table, mode is the requested mode
+    GRANT,              // mode is the mode now held, lower after a downgrade
+    RELEASE,            // an unlock, explicit, by escalation, or by finish and abort
+    ABORT,              // rolled back, after a RELEASE for each lock it held
+    FINISH,             // finished, after a RELEASE for each lock it held
+    DENY,               // a try request that would have had to wait
+};
+
+inline constexpr std::uint8_t EVENT_TRY = 1;           // REQUEST flag: try_acquire, never waits
+inline constexpr std::uint8_t EVENT_END = 2;           // RELEASE flag: released by finish or abort
+inline constexpr std::uint8_t EVENT_DOWNGRADE = 4;     // GRANT flag: downgrade_lock, no request before it
+
+struct LockEvent {
+    std::uint64_t time;                                 // ns since the recorder was created
+    ResourceId rid;
+    std::int32_t tid;
+    LockEventKind kind;
+    std::uint8_t mode;                                  // a LockMode
+    std::uint8_t flags;
+    std::uint8_t reserved;
+};
+static_assert(sizeof(LockEvent) == 24, "the record size is part of the file format");
+
+struct LockTraceHeader {
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t record_size;
+    std::uint64_t capacity;                             // records the file has room for
+    std::atomic<std::uint64_t> next;                    // records claimed, may pass capacity
+    std::atomic<std::uint64_t> dropped;
+    std::uint64_t reserved[3];
+};
+static_assert(sizeof(LockTraceHeader) == 64, "the header size is part of the file format");
+
+class LockRecorder {
+public:
+    // creates or truncates path with room for capacity events, throws if it cannot
+    LockRecorder(const std::string& path, std::size_t capacity);
+    ~LockRecorder();
+    LockRecorder(const LockRecorder&) = delete;
+    LockRecorder& operator=(const LockRecorder&) = delete;
+
+    void record(LockEventKind kind, int tid, ResourceId rid = 0, LockMode mode = LockMode::IS,
+                std::uint8_t flags = 0) {
+        std::uint64_t index = header->next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= header->capacity) {
+            header->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto now = std::chrono::steady_clock::now() - start;
+        events[index] = {static_cast<std::uint64_t>(std::chrono::nanoseconds(now).count()), rid,
+                         static_cast<std::int32_t>(tid), kind, static_cast<std::uint8_t>(mode), flags, 0};
+    }
+
+    std::uint64_t recorded() const;
+    std::uint64_t dropped() const { return header->dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::string path;
+    std::size_t size = 0;
+    LockTraceHeader* header = nullptr;
+    LockEvent* events = nullptr;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+class LockTrace {
+public:
+    // maps a trace written by LockRecorder, throws if path is not one
+    explicit LockTrace(const std::string& path);
+    ~LockTrace();
+    LockTrace(const LockTrace&) = delete;
+    LockTrace& operator=(const LockTrace&) = delete;
+
+    // in the order the events claimed their records, which may differ from time order
+    // by a few records between threads
+    std::span<const LockEvent> events() const { return {first, count}; }
+    std::uint64_t dropped() const { return header->dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::size_t size = 0;
+    const LockTraceHeader* header = nullptr;
+    const LockEvent* first = nullptr;
+    std::size_t count = 0;
+};
+
+const char* event_name(LockEventKind kind);
@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Always-on lock manager metrics. Counters and wait histograms are sharded: every
+// thread updates its own cache-line aligned shard with relaxed atomics, and a snapshot
+// sums the shards. Contended resources are counted in a small space-saving sketch that
+// only sees a sample of the waits, so the hot path never takes a shared lock.
+
+// WAKEUPS counts the blocked transactions notified: granted waiters, victims, and
+// range waiters sent to recheck their range
+enum class Counter { GRANTS, WAITS, TIMEOUTS, DEADLOCKS, ESCALATIONS, WAKEUPS, COUNT };
+
+enum class AbortCause {
+    DEADLOCK,               // cycle victim, or aborted by a prevention policy
+    TIMEOUT,
+    PROTOCOL_VIOLATION,
+    USER,                   // abort_transaction
+    COUNT,
+};
+
+// Log-linear buckets in the style of HDR histograms: every power of two of nanoseconds
+// is split into SUB_BUCKETS linear steps, so any value is off by at most 1/SUB_BUCKETS.
+struct LatencyHistogram {
+    static constexpr int SUB_BITS = 3;
+    static constexpr std::uint64_t SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int MAX_BITS = 36;                 // about 68 s, longer waits land in the last bucket
+    static constexpr std::size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    std::uint64_t count = 0;
+    std::uint64_t total_ns = 0;
+    std::array<std::uint64_t, BUCKETS> buckets{};
+
+    static std::size_t bucket_of(std::uint64_t ns) {
+        if (ns < SUB_BUCKETS) return ns;
+        int shift = std::min(static_cast<int>(std::bit_width(ns)) - 1, MAX_BITS - 1) - SUB_BITS;
+        std::uint64_t sub = std::min(ns >> shift, 2 * SUB_BUCKETS - 1) & (SUB_BUCKETS - 1);
+        return (shift + 1) * SUB_BUCKETS + sub;
+    }
+
+    // smallest value that falls into bucket b
+    static std::uint64_t lower_bound(std::size_t b) {
+        if (b < SUB_BUCKETS) return b;
+        return (SUB_BUCKETS + b % SUB_BUCKETS) << (b / SUB_BUCKETS - 1);
+    }
+
+    // upper edge of the bucket holding the q-th quantile, 0 when empty
+    std::chrono::nanoseconds percentile(double q) const {
+        std::uint64_t rank = static_cast<std::uint64_t>(q * count);
+        std::uint64_t seen = 0;
+        for (std::size_t b = 0; b < BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen > rank) return std::chrono::nanoseconds(b + 1 < BUCKETS ? lower_bound(b + 1) : lower_bound(b));
+        }
+        return std::chrono::nanoseconds(0);
+    }
+
+    std::chrono::nanoseconds mean() const {
+        return std::chrono::nanoseconds(count ? total_ns / count : 0);
+    }
+};
+
+struct HotResource {
+    std::uint64_t rid;
+    std::uint64_t waits;                                // estimate, scaled up by the sample rate
+};
+
+struct LockStats {
+    static constexpr std::size_t MODES = 5;             // one wait histogram per LockMode
+
+    std::array<std::uint64_t, static_cast<std::size_t>(Counter::COUNT)> counters{};
+    std::array<std::uint64_t, static_cast<std::size_t>(AbortCause::COUNT)> aborts{};
+    std::array<LatencyHistogram, MODES> wait_time;      // granted waits only
+    std::vector<HotResource> hot;                       // most contended first
+
+    std::uint64_t operator[](Counter c) const { return counters[static_cast<std::size_t>(c)]; }
+    std::uint64_t operator[](AbortCause c) const { return aborts[static_cast<std::size_t>(c)]; }
+};
+
+class LockMetrics {
+public:
+    static constexpr std::size_t SHARDS = 16;
+    static constexpr std::uint32_t HOT_SAMPLE = 4;      // one wait in this many reaches the sketch
+    static constexpr std::size_t HOT_SLOTS = 64;        // sketch capacity, a few times TOP_K
+    static constexpr std::size_t TOP_K = 16;
+
+    void count(Counter c) {
+        local().counters[static_cast<std::size_t>(c)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void abort(AbortCause cause) {
+        local().aborts[static_cast<std::size_t>(cause)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void wait_time(std::size_t mode, std::chrono::nanoseconds waited) {
+        std::uint64_t ns = std::max<std::int64_t>(waited.count(), 0);
+        Shard& shard = local();
+        shard.wait_count[mode].fetch_add(1, std::memory_order_relaxed);
+        shard.wait_total[mode].fetch_add(ns, std::memory_order_relaxed);
+        shard.wait_buckets[mode][LatencyHistogram::bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void contended(std::uint64_t rid) {
+        thread_local std::uint32_t tick = 0;
+        if (++tick % HOT_SAMPLE != 0) return;
+        std::unique_lock<std::mutex> lock(hot_mtx);
+        // space-saving: a new rid replaces the smallest count and inherits it as its error
+        auto slot = std::find_if(hot.begin(), hot.end(), [rid](const HotResource& h) { return h.rid == rid; });
+        if (slot == hot.end()) {
+            if (hot.size() < HOT_SLOTS) {
+                hot.push_back({rid, 0});
+                slot = hot.end() - 1;
+            } else {
+                slot = std::min_element(hot.begin(), hot.end(),
+                                        [](const HotResource& a, const HotResource& b) { return a.waits < b.waits; });
+                slot->rid = rid;
+            }
+        }
+        slot->waits++;
+    }
+
+    LockStats snapshot() const {
+        LockStats stats;
+        for (const Shard& shard : shards) {
+            for (std::size_t i = 0; i < stats.counters.size(); i++) {
+                stats.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+            }
+            for (std::size_t i = 0; i < stats.aborts.size(); i++) {
+                stats.aborts[i] += shard.aborts[i].load(std::memory_order_relaxed);
+            }
+            for (std::size_t m = 0; m < LockStats::MODES; m++) {
+                LatencyHistogram& h = stats.wait_time[m];
+                h.count += shard.wait_count[m].load(std::memory_order_relaxed);
+                h.total_ns += shard.wait_total[m].load(std::memory_order_relaxed);
+                for (std::size_t b = 0; b < LatencyHistogram::BUCKETS; b++) {
+                    h.buckets[b] += shard.wait_buckets[m][b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(hot_mtx);
+        stats.hot = hot;
+        lock.unlock();
+        std::sort(stats.hot.begin(), stats.hot.end(),
+                  [](const HotResource& a, const HotResource& b) { return a.waits > b.waits; });
+        if (stats.hot.size() > TOP_K) stats.hot.resize(TOP_K);
+        for (HotResource& h : stats.hot) h.waits *= HOT_SAMPLE;
+        return stats;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(Counter::COUNT)> counters{};
+        std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(AbortCause::COUNT)> aborts{};
+        std::array<std::atomic<std::uint64_t>, LockStats::MODES> wait_count{};
+        std::array<std::atomic<std::uint64_t>, LockStats::MODES> wait_total{};
+        std::array<std::array<std::atomic<std::uint64_t>, LatencyHistogram::BUCKETS>, LockStats::MODES> wait_buckets{};
+    };
+
+    std::array<Shard, SHARDS> shards;
+    mutable std::mutex hot_mtx;                         // guards hot, taken by sampled waits only
+    std::vector<HotResource> hot;
+
+    Shard& local() {
+        // threads are dealt shards round robin on first use
+        static std::atomic<std::size_t> next_shard{0};
+        thread_local std::size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return shards[shard];
+    }
+};
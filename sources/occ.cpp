@@ -0,0 +1,135 @@
+#include "occ.h"
+
+OccManager::OccManager(LockManager& lm, int num_transactions, std::size_t num_partitions) : lm(lm) {
+    num_partitions = std::bit_ceil(std::max<std::size_t>(num_partitions, 1));
+    partitions = std::make_unique<VersionPartition[]>(num_partitions);
+    partition_mask = num_partitions - 1;
+    transactions = std::make_unique<Transaction[]>(num_transactions);
+}
+
+OccManager::VersionPartition& OccManager::partition_of(ResourceId rid) {
+    return partitions[(rid * 0x9E3779B97F4A7C15ull >> 32) & partition_mask];
+}
+
+std::atomic<std::uint64_t>* OccManager::find_version(ResourceId rid) {
+    VersionPartition& p = partition_of(rid);
+    std::shared_lock<std::shared_mutex> latch(p.latch);
+    auto it = p.versions.find(rid);
+    return it == p.versions.end() ? nullptr : &it->second;
+}
+
+std::atomic<std::uint64_t>& OccManager::version_slot(ResourceId rid) {
+    if (std::atomic<std::uint64_t>* slot = find_version(rid)) return *slot;
+    VersionPartition& p = partition_of(rid);
+    std::unique_lock<std::shared_mutex> latch(p.latch);
+    return p.versions.try_emplace(rid, 0).first->second;
+}
+
+void OccManager::begin_transaction(int tid) {
+    transactions[tid].reads.clear();
+    transactions[tid].writes.clear();
+    trace<TraceLevel::INFO>("Transaction {} has begun optimistically", tid);
+}
+
+std::uint64_t OccManager::read(int tid, ResourceId rid) {
+    std::uint64_t version = 0;
+    if (std::atomic<std::uint64_t>* slot = find_version(rid)) {
+        // an odd version is being installed right now, wait for it rather than read it:
+        // a committer's install is short, so yield first, then back off until READ_WAIT
+        auto deadline = std::chrono::steady_clock::now() + READ_WAIT;
+        for (int spins = 0; (version = slot->load(std::memory_order_acquire)) & 1; spins++) {
+            if (spins < 64) {
+                std::this_thread::yield();
+            } else if (std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            } else {
+                trace<TraceLevel::ERROR>("Transaction {} gave up waiting for resource {} being written", tid, rid);
+                abort_transaction(tid);
+            }
+        }
+    }
+    transactions[tid].reads.push_back({rid, version});
+    return version;
+}
+
+void OccManager::write(int tid, ResourceId rid, std::function<void()> install) {
+    transactions[tid].writes.push_back({rid, std::move(install)});
+}
+
+void OccManager::abort_transaction(int tid) {
+    transactions[tid].reads.clear();
+    transactions[tid].writes.clear();
+    trace<TraceLevel::ERROR>("Aborting transaction {}", tid);
+    throw std::runtime_error("abort_transaction");
+}
+
+void OccManager::begin_write(ResourceId rid) {
+    version_slot(rid).fetch_add(1);
+}
+
+void OccManager::end_write(ResourceId rid) {
+    version_slot(rid).fetch_add(1, std::memory_order_release);
+}
+
+bool OccManager::validate(int tid, const std::vector<ResourceId>& written) {
+    // backward validation: every version read must still be current, apart from the
+    // install mark this transaction put on the resources it writes itself
+    for (const ReadItem& item : transactions[tid].reads) {
+        std::atomic<std::uint64_t>* slot = find_version(item.rid);
+        std::uint64_t current = slot ? slot->load() : 0;
+        bool own = std::binary_search(written.begin(), written.end(), item.rid);
+        if (current != item.version + own) {
+            trace<TraceLevel::INFO>("Transaction {} read version {} of resource {}, now at {}",
+                        tid, item.version, item.rid, current);
+            return false;
+        }
+    }
+    return true;
+}
+
+LockResult OccManager::commit_transaction(int tid) {
+    Transaction& txn = transactions[tid];
+    std::vector<ResourceId> written;
+    for (const WriteItem& item : txn.writes) written.push_back(item.rid);
+    std::sort(written.begin(), written.end());
+    written.erase(std::unique(written.begin(), written.end()), written.end());
+
+    LockResult result = LockResult::GRANTED;
+    if (written.empty()) {
+        // read-only, no locks needed
+        if (!validate(tid, written)) result = LockResult::VALIDATION_FAILED;
+    } else {
+        std::vector<LockSpec> requests;
+        for (ResourceId rid : written) requests.push_back({rid, LockMode::X});
+        lm.begin_transaction(tid);
+        result = lm.acquire_many(tid, requests);
+        if (result == LockResult::GRANTED) {
+            // marking before validating means two committers that each read what the
+            // other writes cannot both pass
+            std::vector<std::atomic<std::uint64_t>*> slots;
+            for (ResourceId rid : written) {
+                slots.push_back(&version_slot(rid));
+                slots.back()->fetch_add(1);
+            }
+            if (validate(tid, written)) {
+                for (WriteItem& item : txn.writes) {
+                    if (item.install) item.install();
+                }
+                for (auto* slot : slots) slot->fetch_add(1, std::memory_order_release);
+            } else {
+                for (auto* slot : slots) slot->fetch_sub(1, std::memory_order_release);
+                result = LockResult::VALIDATION_FAILED;
+            }
+            lm.finish_transaction(tid);
+        }
+    }
+
+    txn.reads.clear();
+    txn.writes.clear();
+    if (result == LockResult::GRANTED) {
+        trace<TraceLevel::INFO>("Transaction {} committed optimistically", tid);
+    } else {
+        trace<TraceLevel::ERROR>("Aborting transaction {}: {}", tid, result_name(result));
+    }
+    return result;
+}
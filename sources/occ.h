@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "lockmanager.h"
+
+// Optimistic concurrency control over the lock manager's resource id space. A
+// transaction reads without locking, recording the version of every resource it
+// reads, and buffers its writes. Commit locks the write set in X mode through the
+// lock manager, validates that nothing it read has changed since, then installs the
+// writes and bumps their versions before releasing the locks. Because the write
+// locks are ordinary lock manager locks, OCC and 2PL transactions can run side by
+// side on the same resources. They share the tid space too: a tid runs one
+// transaction at a time, in either engine. A 2PL transaction that updates a resource
+// brackets the update with begin_write and end_write under its X lock: in between the
+// version is odd, so OCC readers wait rather than read the uncommitted value, and
+// those that read it earlier fail validation. Since a 2PL writer may keep a resource
+// marked for as long as its transaction runs, even waiting for a lock an OCC committer
+// holds, a reader waits at most READ_WAIT and then aborts.
+
+class OccManager {
+public:
+    static constexpr std::size_t DEFAULT_PARTITIONS = 64;
+    static constexpr std::chrono::milliseconds READ_WAIT{10};
+
+    explicit OccManager(LockManager& lm, int num_transactions = LockManager::DEFAULT_TRANSACTIONS,
+                        std::size_t num_partitions = DEFAULT_PARTITIONS);
+
+    void begin_transaction(int tid);
+    // committed version of rid, recorded in the read set; if rid stays marked by a
+    // writer for READ_WAIT the transaction is aborted as by abort_transaction
+    std::uint64_t read(int tid, ResourceId rid);
+    // buffered until commit; install runs while the X lock on rid is held
+    void write(int tid, ResourceId rid, std::function<void()> install = {});
+    // GRANTED once committed; VALIDATION_FAILED, or the lock manager's result when a
+    // write lock could not be taken, means nothing was installed and the transaction
+    // may begin again
+    LockResult commit_transaction(int tid);
+    void abort_transaction(int tid);
+
+    // for 2PL writers holding the X lock on rid: begin_write before changing it,
+    // end_write once the change is committed or undone, before releasing the lock
+    void begin_write(ResourceId rid);
+    void end_write(ResourceId rid);
+
+private:
+    struct ReadItem {
+        ResourceId rid;
+        std::uint64_t version;
+    };
+
+    struct WriteItem {
+        ResourceId rid;
+        std::function<void()> install;
+    };
+
+    struct alignas(CACHE_LINE) Transaction {
+        std::vector<ReadItem> reads;
+        std::vector<WriteItem> writes;
+    };
+
+    // Versions are even while a resource is at rest and odd while a committer or a 2PL
+    // writer holding its X lock changes it. Resources never written have no slot and read as 0; a
+    // slot once created lives as long as the manager.
+    struct alignas(CACHE_LINE) VersionPartition {
+        std::shared_mutex latch;                        // guards the map, not the versions
+        std::unordered_map<ResourceId, std::atomic<std::uint64_t>> versions;
+    };
+
+    LockManager& lm;
+    std::unique_ptr<Transaction[]> transactions;
+    std::unique_ptr<VersionPartition[]> partitions;
+    std::size_t partition_mask;
+
+    VersionPartition& partition_of(ResourceId rid);
+    std::atomic<std::uint64_t>* find_version(ResourceId rid);
+    std::atomic<std::uint64_t>& version_slot(ResourceId rid);
+    bool validate(int tid, const std::vector<ResourceId>& written);
+};
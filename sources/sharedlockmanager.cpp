@@ -0,0 +1,758 @@
+#include "sharedlockmanager.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::uint64_t SEGMENT_MAGIC = 0x314C42544B434F4Cull;   // "LOCKTBL1"
+constexpr std::uint64_t RECLAIMING = ~std::uint64_t{0};          // owner of a slot being reclaimed
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free && std::atomic<std::uint64_t>::is_always_lock_free,
+              "atomics in the shared segment must not depend on a process-local lock");
+
+// start time of a process in clock ticks since boot, 0 where /proc cannot tell
+std::uint64_t process_start(pid_t pid) {
+    std::ifstream file(std::format("/proc/{}/stat", pid));
+    std::string stat((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    // the command name may hold spaces and parentheses, the fields resume after the last ')'
+    std::size_t paren = stat.rfind(')');
+    if (paren == std::string::npos) return 0;
+    std::istringstream fields(stat.substr(paren + 1));
+    std::string field;
+    for (int i = 3; i < 22 && fields >> field; i++) {}   // state is field 3, starttime field 22
+    std::uint64_t start = 0;
+    fields >> start;
+    return start;
+}
+
+// A pid alone names a different process once it is reused, so a slot's owner is the
+// pid in the low half and the low half of the process start time in the high half.
+std::uint64_t owner_of(pid_t pid, std::uint64_t start) {
+    return (start & 0xFFFFFFFF) << 32 | static_cast<std::uint32_t>(pid);
+}
+
+bool owner_alive(std::uint64_t owner) {
+    pid_t pid = static_cast<pid_t>(owner & 0xFFFFFFFF);
+    if (kill(pid, 0) != 0 && errno == ESRCH) return false;
+    std::uint64_t start = process_start(pid);
+    return start == 0 || owner_of(pid, start) == owner;
+}
+
+std::size_t align_up(std::size_t n) {
+    return (n + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+}
+
+// A process-shared condition variable counts its waiters, and one killed while waiting
+// never leaves: the next signal can block for good. A futex word keeps no such state.
+void wake(std::atomic<std::uint32_t>& word) {
+    word.fetch_add(1, std::memory_order_release);
+    syscall(SYS_futex, &word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+// returns 0 when woken, ETIMEDOUT, or EAGAIN when word is no longer seen; deadline is
+// on CLOCK_MONOTONIC, as FUTEX_WAIT_BITSET takes it
+int wait_until(std::atomic<std::uint32_t>& word, std::uint32_t seen, const timespec& deadline) {
+    if (syscall(SYS_futex, &word, FUTEX_WAIT_BITSET, seen, &deadline, nullptr, FUTEX_BITSET_MATCH_ANY) == 0) return 0;
+    return errno;
+}
+
+// A process killed inside a latch has made the stores before its last instruction and
+// none after, so the steps rebuild_partition relies on only need the compiler to keep
+// their order. The fence goes between steps.
+void step() {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+timespec deadline_after(std::chrono::milliseconds timeout) {
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    auto ns = deadline.tv_nsec + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    deadline.tv_sec += ns / 1'000'000'000;
+    deadline.tv_nsec = ns % 1'000'000'000;
+    return deadline;
+}
+
+}
+
+// Sizes and positions of everything in the segment, fixed by its creator.
+struct SharedLockManager::Geometry {
+    std::uint32_t num_transactions;
+    std::uint32_t num_partitions;                       // power of two
+    std::uint32_t entries_per_partition;
+    std::uint32_t requests_per_partition;
+    std::uint32_t index_bits;                           // each partition hashes into 2^index_bits slots
+    std::uint64_t size;
+    ShmOffset<Transaction> transactions;
+    ShmOffset<Partition> partitions;
+    ShmOffset<ShmOffset<Entry>> indexes;
+    ShmOffset<Entry> entries;
+    ShmOffset<Request> requests;
+};
+
+struct SharedLockManager::Header {
+    std::uint64_t magic;
+    std::atomic<std::uint32_t> ready{0};                // set once the creator has initialized the rest
+    Geometry geometry;
+};
+
+struct alignas(CACHE_LINE) SharedLockManager::Transaction {
+    std::atomic<std::uint64_t> owner{0};                // process running it, see owner_of; 0 when free
+    Phase phase = Phase::GROWING;
+    ShmOffset<Request> locks;                           // its requests, granted or waiting
+    std::atomic<std::uint32_t> wakeup{0};               // futex word, bumped to wake the transaction
+};
+
+struct alignas(CACHE_LINE) SharedLockManager::Partition {
+    pthread_mutex_t latch;                              // robust and process-shared, guards all below
+    std::uint32_t number;
+    std::uint32_t live = 0;                             // entries in use
+    ShmOffset<ShmOffset<Entry>> index;                  // open addressing, linear probing
+    ShmOffset<Entry> free_entries;
+    ShmOffset<Request> free_requests;
+};
+
+struct SharedLockManager::Entry {
+    ResourceId rid;
+    std::uint32_t partition;
+    std::uint32_t waiting;                              // requests and conversions not granted yet
+    std::uint32_t granted[5];                           // granted requests per LockMode
+    ShmOffset<Request> head, tail;                      // in arrival order
+    ShmOffset<Entry> next_free;
+};
+
+struct SharedLockManager::Request {
+    ShmOffset<Entry> entry;
+    ShmOffset<Request> prev, next;                      // in the entry's queue
+    ShmOffset<Request> txn_prev, txn_next;              // in the transaction's list, or the free list
+    std::int32_t tid;
+    LockMode mode;                                      // held, or asked for while not granted
+    LockMode wanted;                                    // differs from mode while a conversion waits
+    bool granted;
+};
+
+template <typename T>
+T* SharedLockManager::at(ShmOffset<T> offset) const {
+    return offset ? reinterpret_cast<T*>(base + offset.offset) : nullptr;
+}
+
+template <typename T>
+ShmOffset<T> SharedLockManager::offset_of(const T* object) const {
+    return {object ? static_cast<std::uint64_t>(reinterpret_cast<const char*>(object) - base) : 0};
+}
+
+void SharedLockManager::layout(Geometry& g) {
+    std::size_t offset = align_up(sizeof(Header));
+    g.transactions = {offset};
+    offset += align_up(sizeof(Transaction) * g.num_transactions);
+    g.partitions = {offset};
+    offset += align_up(sizeof(Partition) * g.num_partitions);
+    g.indexes = {offset};
+    offset += align_up(sizeof(ShmOffset<Entry>) * g.num_partitions << g.index_bits);
+    g.entries = {offset};
+    offset += align_up(sizeof(Entry) * g.num_partitions * g.entries_per_partition);
+    g.requests = {offset};
+    offset += align_up(sizeof(Request) * g.num_partitions * g.requests_per_partition);
+    g.size = offset;
+}
+
+SharedLockManager::SharedLockManager(const std::string& name, SharedTableOptions options)
+    : name(name), lock_timeout(options.lock_timeout) {
+    Geometry geometry{};
+    geometry.num_transactions = static_cast<std::uint32_t>(std::max(options.num_transactions, 1));
+    geometry.num_partitions = static_cast<std::uint32_t>(std::bit_ceil(std::max<std::size_t>(options.num_partitions, 1)));
+    geometry.entries_per_partition = std::max<std::uint32_t>(options.entries_per_partition, 1);
+    geometry.requests_per_partition = std::max<std::uint32_t>(options.requests_per_partition, 1);
+    // at most half full, so probe sequences stay short
+    geometry.index_bits = std::bit_width(2 * geometry.entries_per_partition - 1);
+    layout(geometry);
+
+    bool created = true;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        created = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), std::format("shm_open {}", name));
+
+    if (created) {
+        if (ftruncate(fd, static_cast<off_t>(geometry.size)) != 0) {
+            int error = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::system_error(error, std::generic_category(), std::format("ftruncate {}", name));
+        }
+        size = geometry.size;
+    } else {
+        // the creator sizes the segment right after creating it
+        struct stat st{};
+        auto give_up = std::chrono::steady_clock::now() + lock_timeout;
+        while (fstat(fd, &st) == 0 && st.st_size == 0 && std::chrono::steady_clock::now() < give_up) {
+            std::this_thread::yield();
+        }
+        size = static_cast<std::size_t>(st.st_size);
+    }
+    void* mapping = size ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    int error = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) throw std::system_error(error, std::generic_category(), std::format("mmap {}", name));
+    base = static_cast<char*>(mapping);
+
+    if (created) {
+        header = new (base) Header;
+        header->magic = SEGMENT_MAGIC;
+        header->geometry = geometry;
+        initialize(geometry);
+        header->ready.store(1, std::memory_order_release);
+        trace<TraceLevel::INFO>("Created shared lock table {} of {} bytes", name, size);
+        return;
+    }
+
+    header = reinterpret_cast<Header*>(base);
+    auto give_up = std::chrono::steady_clock::now() + lock_timeout;
+    while (header->ready.load(std::memory_order_acquire) == 0 && std::chrono::steady_clock::now() < give_up) {
+        std::this_thread::yield();
+    }
+    if (header->ready.load(std::memory_order_acquire) == 0 || header->magic != SEGMENT_MAGIC ||
+        header->geometry.size != size) {
+        munmap(base, size);
+        throw std::runtime_error(std::format("{} is not an initialized shared lock table", name));
+    }
+    trace<TraceLevel::INFO>("Attached to shared lock table {}", name);
+    reclaim_stale();
+}
+
+SharedLockManager::~SharedLockManager() {
+    munmap(base, size);
+}
+
+void SharedLockManager::remove(const std::string& name) {
+    shm_unlink(name.c_str());
+}
+
+void SharedLockManager::initialize(const Geometry& g) {
+    for (std::uint32_t tid = 0; tid < g.num_transactions; tid++) {
+        new (&transaction(tid)) Transaction;
+    }
+
+    // a process that dies holding a latch must not leave it locked for everyone else
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+    for (std::uint32_t i = 0; i < g.num_partitions; i++) {
+        Partition* p = new (&partition(i)) Partition;
+        pthread_mutex_init(&p->latch, &mutex_attr);
+        p->number = i;
+        p->index = {g.indexes.offset + (static_cast<std::uint64_t>(i) * sizeof(ShmOffset<Entry>) << g.index_bits)};
+        // the segment starts zeroed, so the index is empty and only the free lists need linking
+        Entry* entries = at(g.entries) + static_cast<std::size_t>(i) * g.entries_per_partition;
+        for (std::uint32_t e = g.entries_per_partition; e-- > 0;) {
+            entries[e].next_free = p->free_entries;
+            p->free_entries = offset_of(&entries[e]);
+        }
+        Request* requests = at(g.requests) + static_cast<std::size_t>(i) * g.requests_per_partition;
+        for (std::uint32_t r = g.requests_per_partition; r-- > 0;) {
+            requests[r].txn_next = p->free_requests;
+            p->free_requests = offset_of(&requests[r]);
+        }
+    }
+    pthread_mutexattr_destroy(&mutex_attr);
+}
+
+SharedLockManager::Transaction& SharedLockManager::transaction(int tid) const {
+    return at(header->geometry.transactions)[tid];
+}
+
+SharedLockManager::Partition& SharedLockManager::partition(std::uint32_t index) const {
+    return at(header->geometry.partitions)[index];
+}
+
+SharedLockManager::Partition& SharedLockManager::partition_of(ResourceId rid) const {
+    return partition((rid * 0x9E3779B97F4A7C15ull >> 32) & (header->geometry.num_partitions - 1));
+}
+
+void SharedLockManager::lock_partition(Partition& p) {
+    int rc = pthread_mutex_lock(&p.latch);
+    if (rc == EOWNERDEAD) {
+        recover_partition(p);
+    } else if (rc != 0) {
+        throw std::system_error(rc, std::generic_category(), "pthread_mutex_lock");
+    }
+}
+
+void SharedLockManager::recover_partition(Partition& p) {
+    // called with the latch of a holder that died, returns with it held again
+    trace<TraceLevel::ERROR>("Latch of shared partition {} was held by a process that exited", p.number);
+    pthread_mutex_consistent(&p.latch);
+    std::vector<int> stale = rebuild_partition(p);
+    if (stale.empty()) return;
+    pthread_mutex_unlock(&p.latch);
+    for (int tid : stale) {
+        trace<TraceLevel::ERROR>("Reclaiming transaction {} of exited process", tid);
+        rollback(tid);
+        transaction(tid).owner.store(0, std::memory_order_release);
+    }
+    lock_partition(p);
+}
+
+std::vector<int> SharedLockManager::rebuild_partition(Partition& p) {
+    // The dead holder may have stopped between any two stores of a change. Each change
+    // keeps the forward links whole: an entry is in some index slot from creation to
+    // removal, at times in two while removal shifts it, and a request is reachable
+    // from its entry's head from linking to unlinking. Everything else, the back links,
+    // the counts and the free lists, is rebuilt from those.
+    const Geometry& g = header->geometry;
+    Entry* entries = at(g.entries) + static_cast<std::size_t>(p.number) * g.entries_per_partition;
+    Request* requests = at(g.requests) + static_cast<std::size_t>(p.number) * g.requests_per_partition;
+    ShmOffset<Entry>* slots = at(p.index);
+
+    // the requests of exited processes are dropped, their transactions claimed for the caller to roll back
+    std::vector<int> stale;
+    enum : std::uint8_t { UNKNOWN, LIVE, CLAIMED };
+    std::vector<std::uint8_t> state(g.num_transactions, UNKNOWN);
+    auto is_stale = [&](int tid) {
+        if (state[tid] == UNKNOWN) {
+            Transaction& txn = transaction(tid);
+            std::uint64_t owner = txn.owner.load(std::memory_order_acquire);
+            bool dead = owner == 0 || (owner != RECLAIMING && !owner_alive(owner));
+            state[tid] = dead && txn.owner.compare_exchange_strong(owner, RECLAIMING) ? CLAIMED : LIVE;
+            if (state[tid] == CLAIMED) stale.push_back(tid);
+        }
+        return state[tid] == CLAIMED;
+    };
+
+    std::vector<bool> entry_used(g.entries_per_partition), request_used(g.requests_per_partition);
+    std::vector<Entry*> live;
+    for (std::size_t i = 0; i < std::size_t{1} << g.index_bits; i++) {
+        Entry* entry = at(slots[i]);
+        slots[i] = {};
+        if (!entry || entry_used[entry - entries]) continue;
+        entry_used[entry - entries] = true;
+
+        Request* req = at(entry->head);
+        Request* last = nullptr;
+        entry->head = {};
+        entry->waiting = 0;
+        std::fill(std::begin(entry->granted), std::end(entry->granted), 0);
+        for (std::uint32_t steps = 0; req && !request_used[req - requests] && steps < g.requests_per_partition;
+             steps++, req = at(req->next)) {
+            if (is_stale(req->tid)) continue;
+            request_used[req - requests] = true;
+            req->prev = offset_of(last);
+            if (last) last->next = offset_of(req); else entry->head = offset_of(req);
+            last = req;
+            if (req->granted) entry->granted[static_cast<int>(req->mode)]++;
+            if (!req->granted || req->wanted != req->mode) entry->waiting++;
+        }
+        if (last) last->next = {};
+        entry->tail = offset_of(last);
+        if (last) live.push_back(entry); else entry_used[entry - entries] = false;
+    }
+
+    p.free_entries = {};
+    for (std::uint32_t e = g.entries_per_partition; e-- > 0;) {
+        if (entry_used[e]) continue;
+        entries[e].next_free = p.free_entries;
+        p.free_entries = offset_of(&entries[e]);
+    }
+    // A dropped request leaves its transaction's list too, one that was being unlinked
+    // finishes leaving it. Each store is checked first, so it never undoes a link made
+    // since; claimed transactions keep their requests in other partitions for the rollback.
+    p.free_requests = {};
+    for (std::uint32_t r = g.requests_per_partition; r-- > 0;) {
+        if (request_used[r]) continue;
+        Request* req = &requests[r];
+        Request* prev = at(req->txn_prev);
+        Request* next = at(req->txn_next);
+        if (prev && prev->txn_next == offset_of(req)) prev->txn_next = req->txn_next;
+        if (transaction(req->tid).locks == offset_of(req)) transaction(req->tid).locks = req->txn_next;
+        if (next && next->txn_prev == offset_of(req)) next->txn_prev = req->txn_prev;
+        requests[r] = Request{};
+        requests[r].txn_next = p.free_requests;
+        p.free_requests = offset_of(&requests[r]);
+    }
+    p.live = static_cast<std::uint32_t>(live.size());
+    for (Entry* entry : live) index_entry(p, entry);
+
+    // the dead holder may have granted a request without waking its transaction
+    for (Entry* entry : live) {
+        grant_waiters(*entry);
+        for (Request* req = at(entry->head); req; req = at(req->next)) {
+            if (req->granted && req->wanted == req->mode) wake(transaction(req->tid).wakeup);
+        }
+    }
+    trace<TraceLevel::ERROR>("Rebuilt shared partition {} with {} entries", p.number, live.size());
+    return stale;
+}
+
+SharedLockManager::Entry* SharedLockManager::find_entry(Partition& p, ResourceId rid) {
+    const std::uint32_t bits = header->geometry.index_bits;
+    ShmOffset<Entry>* slots = at(p.index);
+    for (std::size_t i = rid * 0x9E3779B97F4A7C15ull >> (64 - bits); slots[i]; i = (i + 1) & ((1u << bits) - 1)) {
+        Entry* entry = at(slots[i]);
+        if (entry->rid == rid) return entry;
+    }
+    return nullptr;
+}
+
+SharedLockManager::Entry* SharedLockManager::create_entry(Partition& p, ResourceId rid) {
+    Entry* entry = at(p.free_entries);
+    if (!entry) return nullptr;
+    p.free_entries = entry->next_free;
+    *entry = Entry{};
+    entry->rid = rid;
+    entry->partition = p.number;
+    step();
+    index_entry(p, entry);
+    p.live++;
+    return entry;
+}
+
+void SharedLockManager::index_entry(Partition& p, Entry* entry) {
+    const std::uint32_t bits = header->geometry.index_bits;
+    ShmOffset<Entry>* slots = at(p.index);
+    std::size_t i = entry->rid * 0x9E3779B97F4A7C15ull >> (64 - bits);
+    while (slots[i]) i = (i + 1) & ((1u << bits) - 1);
+    slots[i] = offset_of(entry);
+}
+
+void SharedLockManager::remove_entry(Partition& p, Entry* entry) {
+    const std::uint32_t bits = header->geometry.index_bits;
+    const std::size_t mask = (std::size_t{1} << bits) - 1;
+    ShmOffset<Entry>* slots = at(p.index);
+    std::size_t hole = entry->rid * 0x9E3779B97F4A7C15ull >> (64 - bits);
+    while (at(slots[hole]) != entry) hole = (hole + 1) & mask;
+
+    // backward shift deletion: move later entries of the probe sequence into the hole
+    // unless that would put them before their home slot
+    slots[hole] = {};
+    for (std::size_t i = (hole + 1) & mask; slots[i]; i = (i + 1) & mask) {
+        std::size_t home = at(slots[i])->rid * 0x9E3779B97F4A7C15ull >> (64 - bits);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots[hole] = slots[i];
+            step();
+            slots[i] = {};
+            hole = i;
+        }
+    }
+    entry->next_free = p.free_entries;
+    p.free_entries = offset_of(entry);
+    p.live--;
+}
+
+bool SharedLockManager::grantable(const Entry& entry, LockMode mode, const Request* own) {
+    for (int m = 0; m < 5; m++) {
+        std::uint32_t others = entry.granted[m] - (own && own->granted && static_cast<int>(own->mode) == m);
+        if (others && !compatible(mode, static_cast<LockMode>(m))) return false;
+    }
+    return true;
+}
+
+void SharedLockManager::grant_waiters(Entry& entry) {
+    // conversions first, and nothing new while one of them still waits
+    bool conversion_waits = false;
+    for (Request* req = at(entry.head); req; req = at(req->next)) {
+        if (!req->granted || req->wanted == req->mode) continue;
+        if (grantable(entry, req->wanted, req)) {
+            trace<TraceLevel::INFO>("Granting upgrade to {} lock on resource {} to waiting transaction {}",
+                        mode_name(req->wanted), entry.rid, req->tid);
+            entry.granted[static_cast<int>(req->mode)]--;
+            entry.granted[static_cast<int>(req->wanted)]++;
+            req->mode = req->wanted;
+            entry.waiting--;
+            wake(transaction(req->tid).wakeup);
+        } else {
+            conversion_waits = true;
+        }
+    }
+    if (conversion_waits) return;
+
+    for (Request* req = at(entry.head); req; req = at(req->next)) {
+        if (req->granted) continue;
+        if (!grantable(entry, req->mode, nullptr)) break;
+        trace<TraceLevel::INFO>("Granting {} lock on resource {} to waiting transaction {}",
+                    mode_name(req->mode), entry.rid, req->tid);
+        req->granted = true;
+        entry.granted[static_cast<int>(req->mode)]++;
+        entry.waiting--;
+        wake(transaction(req->tid).wakeup);
+    }
+}
+
+void SharedLockManager::release_request(int tid, Request* req) {
+    // the caller holds the latch of the request's partition
+    Entry& entry = *at(req->entry);
+    Partition& p = partition(entry.partition);
+    if (req->granted) {
+        entry.granted[static_cast<int>(req->mode)]--;
+        if (req->wanted != req->mode) entry.waiting--;
+    } else {
+        entry.waiting--;
+    }
+
+    if (Request* prev = at(req->prev)) prev->next = req->next; else entry.head = req->next;
+    if (Request* next = at(req->next)) next->prev = req->prev; else entry.tail = req->prev;
+    step();
+    if (Request* prev = at(req->txn_prev)) prev->txn_next = req->txn_next; else transaction(tid).locks = req->txn_next;
+    if (Request* next = at(req->txn_next)) next->txn_prev = req->txn_prev;
+    step();
+    *req = Request{};
+    req->txn_next = p.free_requests;
+    p.free_requests = offset_of(req);
+
+    if (!entry.head) {
+        remove_entry(p, &entry);
+    } else {
+        grant_waiters(entry);
+    }
+}
+
+int SharedLockManager::begin_transaction() {
+    // looked up again after a fork, the child is a process of its own
+    if (self_pid != getpid()) {
+        self_pid = getpid();
+        self = owner_of(self_pid, process_start(self_pid));
+    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        for (std::uint32_t tid = 0; tid < header->geometry.num_transactions; tid++) {
+            std::uint64_t free = 0;
+            if (transaction(tid).owner.compare_exchange_strong(free, self)) {
+                transaction(tid).phase = Phase::GROWING;
+                trace<TraceLevel::INFO>("Transaction {} has begun", tid);
+                return static_cast<int>(tid);
+            }
+        }
+        reclaim_stale();
+    }
+    throw std::runtime_error("no free shared transaction slot");
+}
+
+void SharedLockManager::finish_transaction(int tid) {
+    release_all(tid);
+    transaction(tid).phase = Phase::GROWING;
+    transaction(tid).owner.store(0, std::memory_order_release);
+    trace<TraceLevel::INFO>("Transaction {} has finished", tid);
+}
+
+LockResult SharedLockManager::acquire(int tid, ResourceId rid, LockMode mode) {
+    Transaction& txn = transaction(tid);
+    if (txn.phase == Phase::SHRINKING) {
+        trace<TraceLevel::ERROR>("Transaction {} in shrinking phase, locking violates 2PL protocol.", tid);
+        rollback(tid);
+        return LockResult::PROTOCOL_VIOLATION;
+    }
+
+    Partition& p = partition_of(rid);
+    lock_partition(p);
+    Entry* entry = find_entry(p, rid);
+    Request* own = nullptr;
+    for (Request* req = entry ? at(entry->head) : nullptr; req; req = at(req->next)) {
+        if (req->tid == tid) {
+            own = req;
+            break;
+        }
+    }
+
+    if (own) {
+        LockMode target = supremum(own->mode, mode);
+        if (target == own->mode) {
+            pthread_mutex_unlock(&p.latch);
+            return LockResult::GRANTED;
+        }
+        // convert in place unless another holder's conversion is already waiting;
+        // queued new requests come after conversions and do not hold it back
+        bool conversion_pending = false;
+        for (Request* req = at(entry->head); req; req = at(req->next)) {
+            if (req->granted && req->wanted != req->mode) {
+                conversion_pending = true;
+                break;
+            }
+        }
+        if (!conversion_pending && grantable(*entry, target, own)) {
+            entry->granted[static_cast<int>(own->mode)]--;
+            entry->granted[static_cast<int>(target)]++;
+            own->mode = own->wanted = target;
+            pthread_mutex_unlock(&p.latch);
+            trace<TraceLevel::INFO>("Transaction {} acquired {} lock on resource {}", tid, mode_name(target), rid);
+            return LockResult::GRANTED;
+        }
+        own->wanted = target;
+        entry->waiting++;
+        trace<TraceLevel::INFO>("Transaction {} waiting to upgrade to {} lock on resource {}", tid, mode_name(target), rid);
+    } else {
+        if (!entry) entry = create_entry(p, rid);
+        own = entry ? at(p.free_requests) : nullptr;
+        if (!own) {
+            if (entry && !entry->head) remove_entry(p, entry);
+            pthread_mutex_unlock(&p.latch);
+            trace<TraceLevel::ERROR>("Shared partition {} is full, cannot lock resource {}", p.number, rid);
+            rollback(tid);
+            return LockResult::OUT_OF_SPACE;
+        }
+        p.free_requests = own->txn_next;
+        *own = Request{};
+        own->entry = offset_of(entry);
+        own->tid = tid;
+        own->mode = own->wanted = mode;
+        own->prev = entry->tail;
+        // into the entry's queue first, then the transaction's list, see rebuild_partition
+        step();
+        if (Request* tail = at(entry->tail)) tail->next = offset_of(own); else entry->head = offset_of(own);
+        entry->tail = offset_of(own);
+        step();
+        own->txn_next = txn.locks;
+        if (Request* first = at(txn.locks)) first->txn_prev = offset_of(own);
+        step();
+        txn.locks = offset_of(own);
+
+        if (entry->waiting == 0 && grantable(*entry, mode, nullptr)) {
+            own->granted = true;
+            entry->granted[static_cast<int>(mode)]++;
+            pthread_mutex_unlock(&p.latch);
+            trace<TraceLevel::INFO>("Transaction {} acquired {} lock on resource {}", tid, mode_name(mode), rid);
+            return LockResult::GRANTED;
+        }
+        entry->waiting++;
+        trace<TraceLevel::INFO>("Transaction {} waiting for {} lock on resource {}", tid, mode_name(mode), rid);
+    }
+
+    timespec deadline = deadline_after(lock_timeout);
+    while (!own->granted || own->wanted != own->mode) {
+        std::uint32_t seen = txn.wakeup.load(std::memory_order_acquire);
+        pthread_mutex_unlock(&p.latch);
+        int rc = wait_until(txn.wakeup, seen, deadline);
+        // own and its entry stay put while the latch is free: only this transaction removes them
+        lock_partition(p);
+        if (rc == ETIMEDOUT && (!own->granted || own->wanted != own->mode)) {
+            trace<TraceLevel::ERROR>("Transaction {} timed out waiting for {} lock on resource {}",
+                        tid, mode_name(own->wanted), rid);
+            if (own->granted) {
+                own->wanted = own->mode;
+                entry->waiting--;
+                grant_waiters(*entry);
+            } else {
+                release_request(tid, own);
+            }
+            pthread_mutex_unlock(&p.latch);
+            rollback(tid);
+            // the holder may be a process that has exited
+            reclaim_stale();
+            return LockResult::TIMEOUT;
+        }
+    }
+    pthread_mutex_unlock(&p.latch);
+    trace<TraceLevel::INFO>("Transaction {} acquired {} lock on resource {}", tid, mode_name(own->mode), rid);
+    return LockResult::GRANTED;
+}
+
+LockResult SharedLockManager::release(int tid, ResourceId rid) {
+    Partition& p = partition_of(rid);
+    lock_partition(p);
+    Entry* entry = find_entry(p, rid);
+    Request* own = nullptr;
+    for (Request* req = entry ? at(entry->head) : nullptr; req; req = at(req->next)) {
+        if (req->tid == tid && req->granted) {
+            own = req;
+            break;
+        }
+    }
+    if (!own) {
+        pthread_mutex_unlock(&p.latch);
+        trace<TraceLevel::ERROR>("Transaction {} does not hold a lock on resource {}", tid, rid);
+        rollback(tid);
+        return LockResult::PROTOCOL_VIOLATION;
+    }
+    transaction(tid).phase = Phase::SHRINKING;
+    release_request(tid, own);
+    pthread_mutex_unlock(&p.latch);
+    trace<TraceLevel::INFO>("Transaction {} released lock on resource {}", tid, rid);
+    return LockResult::GRANTED;
+}
+
+void SharedLockManager::release_all(int tid) {
+    // requests are allocated per partition, so the partition follows from where the
+    // request is; it is checked again under the latch, as rebuilding may have dropped it
+    const Geometry& g = header->geometry;
+    while (Request* req = at(transaction(tid).locks)) {
+        Partition& p = partition(static_cast<std::uint32_t>((req - at(g.requests)) / g.requests_per_partition));
+        lock_partition(p);
+        if (at(transaction(tid).locks) == req) release_request(tid, req);
+        pthread_mutex_unlock(&p.latch);
+    }
+}
+
+void SharedLockManager::rollback(int tid) {
+    trace<TraceLevel::ERROR>("Aborting transaction {}", tid);
+    release_all(tid);
+    transaction(tid).phase = Phase::GROWING;
+}
+
+std::size_t SharedLockManager::reclaim_stale() {
+    std::size_t reclaimed = 0;
+    bool swept = false;
+    for (std::uint32_t tid = 0; tid < header->geometry.num_transactions; tid++) {
+        Transaction& txn = transaction(tid);
+        std::uint64_t owner = txn.owner.load(std::memory_order_acquire);
+        if (owner == 0 || owner == RECLAIMING || owner_alive(owner)) continue;
+        // A latch the process died holding may hide a request missing from its list, so
+        // every latch is taken once before the slot is: rebuilding that partition drops
+        // the request, and reclaims the transactions that had one there.
+        if (!swept) {
+            for (std::uint32_t i = 0; i < header->geometry.num_partitions; i++) {
+                lock_partition(partition(i));
+                pthread_mutex_unlock(&partition(i).latch);
+            }
+            swept = true;
+        }
+        // whoever swaps the owner out reclaims the slot, so it is released only once
+        if (!txn.owner.compare_exchange_strong(owner, RECLAIMING)) continue;
+        trace<TraceLevel::ERROR>("Reclaiming transaction {} of exited process {}", tid, owner & 0xFFFFFFFF);
+        rollback(static_cast<int>(tid));
+        txn.owner.store(0, std::memory_order_release);
+        reclaimed++;
+    }
+    return reclaimed;
+}
+
+void SharedLockManager::lock(int tid, ResourceId rid, LockMode mode) {
+    if (acquire(tid, rid, mode) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+void SharedLockManager::read_lock(int tid, ResourceId rid) {
+    lock(tid, rid, LockMode::S);
+}
+
+void SharedLockManager::write_lock(int tid, ResourceId rid) {
+    lock(tid, rid, LockMode::X);
+}
+
+void SharedLockManager::unlock(int tid, ResourceId rid) {
+    if (release(tid, rid) != LockResult::GRANTED) {
+        throw std::runtime_error("abort_transaction");
+    }
+}
+
+std::size_t SharedLockManager::live_entries() {
+    std::size_t live = 0;
+    for (std::uint32_t i = 0; i < header->geometry.num_partitions; i++) {
+        lock_partition(partition(i));
+        live += partition(i).live;
+        pthread_mutex_unlock(&partition(i).latch);
+    }
+    return live;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sys/types.h>
+#include "lockmanager.h"
+
+// A lock table shared by the processes on one host. Lock entries, wait queues and
+// transaction descriptors live in a named POSIX shared memory segment that every
+// process maps, wherever it lands in its address space: structures refer to each
+// other by offsets from the start of the segment, never by pointers. Each partition
+// of the table is guarded by a robust, process-shared mutex, and a waiting
+// transaction sleeps on a futex word in its descriptor.
+//
+// The segment has a fixed capacity chosen by whichever process creates it. Processes
+// that attach later take the geometry from the segment and ignore their own options.
+//
+// Deadlocks between processes are resolved by the lock timeout rather than detected.
+// A process that dies holding locks leaves its transactions behind; reclaim_stale
+// rolls back every transaction whose process no longer exists, and runs whenever a
+// process attaches and whenever a wait times out. A process that dies holding the
+// latch of a partition may have left it halfway through a change: the next process
+// to take the latch rebuilds the partition's index, counts and free lists from the
+// lock queues and rolls back the dead transactions first. A process is known by its
+// pid and start time, so a pid reused by a later process does not keep the slot
+// alive. An exited process that its parent has not reaped yet still counts as alive.
+
+struct SharedTableOptions {
+    int num_transactions = 64;
+    std::size_t num_partitions = 16;
+    std::uint32_t entries_per_partition = 1024;         // distinct locked resources
+    std::uint32_t requests_per_partition = 4096;        // granted and waiting lock requests
+    std::chrono::milliseconds lock_timeout{1000};       // per process, not stored in the segment
+};
+
+// Position of a T in the shared segment, 0 is null.
+template <typename T>
+struct ShmOffset {
+    std::uint64_t offset = 0;
+
+    explicit operator bool() const { return offset != 0; }
+    bool operator==(const ShmOffset&) const = default;
+};
+
+class SharedLockManager {
+public:
+    // attaches to the segment called name, creating it when it does not exist yet
+    explicit SharedLockManager(const std::string& name, SharedTableOptions options = {});
+    ~SharedLockManager();
+    SharedLockManager(const SharedLockManager&) = delete;
+    SharedLockManager& operator=(const SharedLockManager&) = delete;
+
+    // unlinks the segment; processes that have it mapped keep using it
+    static void remove(const std::string& name);
+
+    // claims a free transaction slot for this process, throws when all are taken
+    int begin_transaction();
+    void finish_transaction(int tid);
+
+    // Any result other than GRANTED means the transaction was rolled back and its slot
+    // is still claimed: begin again by calling finish_transaction and begin_transaction.
+    // OUT_OF_SPACE means the resource's partition had no room left for the request.
+    LockResult acquire(int tid, ResourceId rid, LockMode mode);
+    LockResult release(int tid, ResourceId rid);
+
+    // throwing wrappers, as in LockManager
+    void lock(int tid, ResourceId rid, LockMode mode);
+    void read_lock(int tid, ResourceId rid);
+    void write_lock(int tid, ResourceId rid);
+    void unlock(int tid, ResourceId rid);
+
+    // rolls back the transactions of processes that have exited, returns how many
+    std::size_t reclaim_stale();
+
+    std::size_t live_entries();
+
+private:
+    struct Geometry;
+    struct Header;
+    struct Transaction;
+    struct Partition;
+    struct Entry;
+    struct Request;
+
+    std::string name;
+    std::chrono::milliseconds lock_timeout;
+    pid_t self_pid = 0;
+    std::uint64_t self = 0;                             // this process as a slot owner
+    std::size_t size = 0;
+    char* base = nullptr;
+    Header* header = nullptr;
+
+    template <typename T> T* at(ShmOffset<T> offset) const;
+    template <typename T> ShmOffset<T> offset_of(const T* object) const;
+
+    static void layout(Geometry& geometry);
+    void initialize(const Geometry& geometry);
+    Transaction& transaction(int tid) const;
+    Partition& partition_of(ResourceId rid) const;
+    Partition& partition(std::uint32_t index) const;
+    void lock_partition(Partition& p);
+    void recover_partition(Partition& p);
+    std::vector<int> rebuild_partition(Partition& p);
+
+    Entry* find_entry(Partition& p, ResourceId rid);
+    Entry* create_entry(Partition& p, ResourceId rid);
+    void index_entry(Partition& p, Entry* entry);
+    void remove_entry(Partition& p, Entry* entry);
+    static bool grantable(const Entry& entry, LockMode mode, const Request* own);
+    void grant_waiters(Entry& entry);
+    void release_request(int tid, Request* req);
+    void release_all(int tid);
+    void rollback(int tid);
+};
@@ -0,0 +1,84 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <print>
+
+// multi-granularity locking: a table scan takes one S lock on the table, point
+// readers coexist with it through IS, point writers wait for it through IX.
+
+void t0(LockManager& lm, int tid) {
+    try {
+        lm.begin_transaction(tid);
+        std::println(">> Transaction {} has started", tid);
+        std::println(">> Transaction {} is trying to acquire read lock on table 1", tid);
+        lm.lock_table(tid, 1, LockMode::S);
+        std::println(">> Transaction {} acquired read lock on table 1", tid);
+        for (std::uint32_t slot = 0; slot < 100; slot++) {
+            lm.lock_row(tid, 1, 0, slot, LockMode::S);   // covered by the table lock
+        }
+        std::println(">> Transaction {} scanned 100 rows of table 1", tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        lm.finish_transaction(tid);
+        std::println(">> Transaction {} has finished", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+void t1(LockManager& lm, int tid) {
+    try {
+        lm.begin_transaction(tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        std::println(">> Transaction {} has started", tid);
+        std::println(">> Transaction {} is trying to acquire write lock on row 5 of table 1", tid);
+        lm.lock_row(tid, 1, 0, 5, LockMode::X);
+        std::println(">> Transaction {} acquired write lock on row 5 of table 1", tid);
+        lm.finish_transaction(tid);
+        std::println(">> Transaction {} has finished", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+void t2(LockManager& lm, int tid) {
+    try {
+        lm.begin_transaction(tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::println(">> Transaction {} has started", tid);
+        std::println(">> Transaction {} is trying to acquire read lock on row 7 of table 1", tid);
+        lm.lock_row(tid, 1, 0, 7, LockMode::S);
+        std::println(">> Transaction {} acquired read lock on row 7 of table 1", tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        lm.finish_transaction(tid);
+        std::println(">> Transaction {} has finished", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+void t3(LockManager& lm, int tid) {
+    try {
+        std::println(">> Transaction {} has started - Print graph transaction", tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        std::println(">> Printing Graph");
+        lm.allocated_edges();
+        lm.request_edges();
+        std::println(">> Transaction {} exitting", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+int main() {
+    {
+        LockManager lm;
+        std::vector<std::jthread> threads;
+        threads.emplace_back(t0, std::ref(lm), 0);
+        threads.emplace_back(t1, std::ref(lm), 1);
+        threads.emplace_back(t2, std::ref(lm), 2);
+        threads.emplace_back(t3, std::ref(lm), 3);
+    }
+    std::println(">> All transactions completed.");
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <print>
+
+// write-write deadlock resolved by the background detector thread; the victim
+// policy aborts the youngest transaction (0) rather than the highest tid (1)
+
+void t0(LockManager& lm, int tid) {
+    try {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        lm.begin_transaction(tid);
+        std::println(">> Transaction {} has started", tid);
+        std::println(">> Transaction {} is trying to acquire write lock on resource 0", tid);
+        lm.write_lock(tid, 0);
+        std::println(">> Transaction {} acquired write lock on resource 0", tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(800));
+        std::println(">> Transaction {} is trying to acquire write lock on resource 1", tid);
+        lm.write_lock(tid, 1);
+        std::println(">> Transaction {} acquired write lock on resource 1", tid);
+        lm.finish_transaction(tid);
+        std::println(">> Transaction {} has finished", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+void t1(LockManager& lm, int tid) {
+    try {
+        lm.begin_transaction(tid);
+        std::println(">> Transaction {} has started", tid);
+        std::println(">> Transaction {} is trying to acquire write lock on resource 1", tid);
+        lm.write_lock(tid, 1);
+        std::println(">> Transaction {} acquired write lock on resource 1", tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        std::println(">> Transaction {} is trying to acquire write lock on resource 0", tid);
+        lm.write_lock(tid, 0);
+        std::println(">> Transaction {} acquired write lock on resource 0", tid);
+        lm.finish_transaction(tid);
+        std::println(">> Transaction {} has finished", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+int main() {
+    auto start = std::chrono::steady_clock::now();
+    {
+        DeadlockOptions options;
+        options.mode = DetectionMode::BACKGROUND;
+        options.interval = std::chrono::milliseconds(5);
+        options.victim_policy = VictimPolicy::YOUNGEST;
+        LockManager lm(LockManager::DEFAULT_TRANSACTIONS, LockManager::DEFAULT_PARTITIONS, options);
+        std::vector<std::jthread> threads;
+        threads.emplace_back(t0, std::ref(lm), 0);
+        threads.emplace_back(t1, std::ref(lm), 1);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::println(">> All transactions completed in {} ms.", elapsed.count());
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <print>
+
+// the write-write deadlock of test00 under each deadlock policy; transaction 0
+// begins first and is the older one.
+// DETECT: the cycle is found and 1 is aborted. WAIT_DIE: 0 waits, 1 dies on its
+// request. WOUND_WAIT: 0 wounds 1, which aborts on its next request. NO_WAIT: 0
+// aborts on its conflicting request and 1 finishes.
+
+void t0(LockManager& lm, int tid) {
+    try {
+        lm.begin_transaction(tid);
+        std::println(">> Transaction {} has started", tid);
+        lm.write_lock(tid, 0);
+        std::println(">> Transaction {} acquired write lock on resource 0", tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        std::println(">> Transaction {} is trying to acquire write lock on resource 1", tid);
+        lm.write_lock(tid, 1);
+        std::println(">> Transaction {} acquired write lock on resource 1", tid);
+        lm.finish_transaction(tid);
+        std::println(">> Transaction {} has finished", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+void t1(LockManager& lm, int tid) {
+    try {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        lm.begin_transaction(tid);
+        std::println(">> Transaction {} has started", tid);
+        lm.write_lock(tid, 1);
+        std::println(">> Transaction {} acquired write lock on resource 1", tid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        std::println(">> Transaction {} is trying to acquire write lock on resource 0", tid);
+        lm.write_lock(tid, 0);
+        std::println(">> Transaction {} acquired write lock on resource 0", tid);
+        lm.finish_transaction(tid);
+        std::println(">> Transaction {} has finished", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+int main() {
+    const char* names[] = {"DETECT", "WAIT_DIE", "WOUND_WAIT", "NO_WAIT"};
+    DeadlockPolicy policies[] = {DeadlockPolicy::DETECT, DeadlockPolicy::WAIT_DIE,
+                                 DeadlockPolicy::WOUND_WAIT, DeadlockPolicy::NO_WAIT};
+    for (int i = 0; i < 4; i++) {
+        std::println(">> Policy {}", names[i]);
+        DeadlockOptions options;
+        options.policy = policies[i];
+        LockManager lm(LockManager::DEFAULT_TRANSACTIONS, LockManager::DEFAULT_PARTITIONS, options);
+        std::vector<std::jthread> threads;
+        threads.emplace_back(t0, std::ref(lm), 0);
+        threads.emplace_back(t1, std::ref(lm), 1);
+    }
+    std::println(">> All transactions completed.");
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <print>
+
+// the write-write deadlock of test00 through the status-returning API: no
+// try/catch, the victim sees DEADLOCK_VICTIM, begins again and then succeeds
+
+void run(LockManager& lm, int tid, ResourceId first, ResourceId second) {
+    for (int attempt = 1; ; attempt++) {
+        lm.begin_transaction(tid);
+        std::println(">> Transaction {} has started, attempt {}", tid, attempt);
+        LockResult result = lm.acquire(tid, first, LockMode::X);
+        if (result == LockResult::GRANTED) {
+            std::println(">> Transaction {} acquired write lock on resource {}", tid, first);
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            result = lm.acquire(tid, second, LockMode::X);
+        }
+        if (result == LockResult::GRANTED) {
+            std::println(">> Transaction {} acquired write lock on resource {}", tid, second);
+            lm.finish_transaction(tid);
+            std::println(">> Transaction {} has finished", tid);
+            return;
+        }
+        std::println(">> Transaction {} failed: {}", tid, result_name(result));
+    }
+}
+
+int main() {
+    {
+        LockManager lm;
+        std::vector<std::jthread> threads;
+        threads.emplace_back(run, std::ref(lm), 0, 0, 1);
+        threads.emplace_back(run, std::ref(lm), 1, 1, 0);
+    }
+    {
+        LockManager lm;
+        lm.begin_transaction(2);
+        std::println(">> Releasing a lock not held: {}", result_name(lm.release(2, 7)));
+        lm.begin_transaction(3);
+        lm.acquire(3, 7, LockMode::S);
+        lm.release(3, 7);
+        std::println(">> Locking after unlocking: {}", result_name(lm.acquire(3, 8, LockMode::S)));
+        lm.begin_transaction(4);
+        lm.acquire(4, 9, LockMode::X);
+        std::println(">> Try lock on a held resource: {}", result_name(lm.try_acquire(5, 9, LockMode::S)));
+        lm.finish_transaction(4);
+    }
+    std::println(">> All transactions completed.");
+    return 0;
+}
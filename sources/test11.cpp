@@ -0,0 +1,45 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <print>
+
+// the two transactions of test00 declare their write sets up front, in opposite
+// order; lock_many takes both in the same canonical order, so one simply waits
+// for the other and neither is aborted
+
+void run(LockManager& lm, int tid, ResourceId first, ResourceId second) {
+    try {
+        lm.begin_transaction(tid);
+        std::println(">> Transaction {} has started", tid);
+        LockSpec write_set[] = {{first, LockMode::X}, {second, LockMode::X}};
+        std::println(">> Transaction {} is trying to acquire write locks on resources {} and {}", tid, first, second);
+        lm.lock_many(tid, write_set);
+        std::println(">> Transaction {} acquired write locks on resources {} and {}", tid, first, second);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        lm.finish_transaction(tid);
+        std::println(">> Transaction {} has finished", tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+int main() {
+    {
+        LockManager lm;
+        std::vector<std::jthread> threads;
+        threads.emplace_back(run, std::ref(lm), 0, 0, 1);
+        threads.emplace_back(run, std::ref(lm), 1, 1, 0);
+    }
+    {
+        LockManager lm;
+        lm.begin_transaction(2);
+        LockSpec read_set[] = {{3, LockMode::S}, {4, LockMode::S}, {3, LockMode::X}};
+        std::println(">> Duplicate requests merge to the stronger mode: {}", result_name(lm.acquire_many(2, read_set)));
+        ResourceId rids[] = {3, 4};
+        std::println(">> Batched unlock: {}", result_name(lm.release_many(2, rids)));
+        std::println(">> Locks left: {}", lm.live_entries());
+    }
+    std::println(">> All transactions completed.");
+    return 0;
+}
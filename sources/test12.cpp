@@ -0,0 +1,55 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <print>
+
+// pooled transaction handles: a manager with four descriptors runs forty
+// transactions on eight threads, each handle begun on one thread and finished on
+// another; a finished handle is stale even after its slot has been reused, and its
+// lock calls are refused without locking anything for the slot's new transaction
+
+int main() {
+    LockManager lm(4);
+    {
+        std::vector<std::jthread> threads;
+        for (int t = 0; t < 8; t++) {
+            threads.emplace_back([&lm, t] {
+                for (int i = 0; i < 5; i++) {
+                    TxnHandle txn;
+                    while (true) {
+                        try {
+                            txn = lm.begin_transaction();
+                            break;
+                        } catch (const std::exception&) {
+                            std::this_thread::yield();   // all four descriptors in use
+                        }
+                    }
+                    lm.write_lock(txn, t % 3);
+                    std::jthread([&lm, txn] { lm.finish_transaction(txn); });
+                }
+            });
+        }
+    }
+    std::println(">> Forty transactions done, locks left: {}", lm.live_entries());
+
+    TxnHandle first = lm.begin_transaction();
+    lm.read_lock(first, 7);
+    lm.finish_transaction(first);
+    TxnHandle second = lm.begin_transaction();
+    std::println(">> Slot {} reused: old handle current {}, new handle current {}",
+                 second.slot, lm.is_current(first), lm.is_current(second));
+    lm.finish_transaction(first);   // stale, ignored
+    std::println(">> Stale handle write lock on resource 8: {}", result_name(lm.acquire(first, 8, LockMode::X)));
+    try {
+        lm.read_lock(first, 9);
+    } catch (const std::exception& e) {
+        std::println(">> Stale handle read lock on resource 9 threw {}", e.what());
+    }
+    std::println(">> New handle release of resource 8: {}", result_name(lm.release(second, 8)));
+    lm.begin_transaction(second);
+    lm.write_lock(second, 7);
+    lm.finish_transaction(second);
+    std::println(">> All transactions completed.");
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <print>
+
+// lock wait limits: transaction 0 holds resource 0 for 500 ms. Transaction 1 has a
+// 10 ms default timeout and gives up, transaction 2 runs NOWAIT and fails at once,
+// transaction 3 waits up to two seconds for this one request and gets the lock.
+// Timed out requests leave the queue, so 3 is granted as soon as 0 finishes.
+// Then, in a single-partition manager so that the batch takes resource 1 before 2,
+// transaction 4 locks resources 1 and 2 as one batch with a 100 ms timeout.
+// Transaction 5 holds 1 for 60 ms and transaction 6 holds 2 for 500 ms: the batch
+// waits for 1, then for 2, and times out 100 ms after it first blocked, not after
+// a fresh 100 ms for 2. Its lock on 1 is rolled back with it.
+
+using namespace std::chrono_literals;
+
+void holder(LockManager& lm, int tid) {
+    lm.begin_transaction(tid);
+    lm.write_lock(tid, 0);
+    std::println(">> Transaction {} acquired write lock on resource 0", tid);
+    std::this_thread::sleep_for(500ms);
+    lm.finish_transaction(tid);
+    std::println(">> Transaction {} has finished", tid);
+}
+
+void waiter(LockManager& lm, int tid, std::chrono::milliseconds lock_timeout, std::chrono::milliseconds request_timeout) {
+    std::this_thread::sleep_for(100ms);
+    lm.begin_transaction(tid, lock_timeout);
+    auto start = std::chrono::steady_clock::now();
+    LockResult result = request_timeout.count() ? lm.acquire(tid, 0, LockMode::S, request_timeout)
+                                                : lm.acquire(tid, 0, LockMode::S);
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::println(">> Transaction {} read lock on resource 0: {}{}", tid, result_name(result),
+                 waited < 50ms ? " without a long wait" : "");
+    if (result == LockResult::GRANTED) lm.finish_transaction(tid);
+}
+
+void batch_holder(LockManager& lm, int tid, ResourceId rid, std::chrono::milliseconds hold) {
+    lm.begin_transaction(tid);
+    lm.write_lock(tid, rid);
+    std::this_thread::sleep_for(hold);
+    lm.finish_transaction(tid);
+}
+
+void batch_waiter(LockManager& lm, int tid) {
+    std::this_thread::sleep_for(20ms);
+    lm.begin_transaction(tid, 100ms);
+    LockSpec requests[] = {{1, LockMode::X}, {2, LockMode::X}};
+    auto start = std::chrono::steady_clock::now();
+    LockResult result = lm.acquire_many(tid, requests);
+    auto waited = std::chrono::steady_clock::now() - start;
+    std::println(">> Transaction {} batch lock on resources 1 and 2: {}{}", tid, result_name(result),
+                 waited < 130ms ? " within the batch timeout" : "");
+    if (result == LockResult::GRANTED) lm.finish_transaction(tid);
+    lm.begin_transaction(tid);
+    std::println(">> Resource 1 after the batch: {}", result_name(lm.try_acquire(tid, 1, LockMode::X)));
+    lm.finish_transaction(tid);
+}
+
+int main() {
+    {
+        LockManager lm;
+        std::vector<std::jthread> threads;
+        threads.emplace_back(holder, std::ref(lm), 0);
+        threads.emplace_back(waiter, std::ref(lm), 1, 10ms, 0ms);
+        threads.emplace_back(waiter, std::ref(lm), 2, 0ms, 0ms);
+        threads.emplace_back(waiter, std::ref(lm), 3, 10ms, 2000ms);
+    }
+    {
+        LockManager lm(LockManager::DEFAULT_TRANSACTIONS, 1);
+        std::vector<std::jthread> threads;
+        threads.emplace_back(batch_holder, std::ref(lm), 5, 1, 60ms);
+        threads.emplace_back(batch_holder, std::ref(lm), 6, 2, 500ms);
+        threads.emplace_back(batch_waiter, std::ref(lm), 4);
+    }
+    std::println(">> All transactions completed.");
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <print>
+
+// metrics: four transactions queue for the hot resource 42 over and over, one runs
+// into a deadlock and one into a timeout; snapshot_stats() then shows the counters,
+// the wait time percentiles for X locks and resource 42 at the top of the hot list
+
+using namespace std::chrono_literals;
+
+void hot_writer(LockManager& lm, int tid) {
+    for (int i = 0; i < 50; i++) {
+        lm.begin_transaction(tid);
+        lm.write_lock(tid, 42);
+        lm.read_lock(tid, 100 + tid);
+        std::this_thread::sleep_for(200us);
+        lm.finish_transaction(tid);
+    }
+}
+
+void deadlocked(LockManager& lm, int tid, ResourceId first, ResourceId second) {
+    try {
+        lm.begin_transaction(tid);
+        lm.write_lock(tid, first);
+        std::this_thread::sleep_for(100ms);
+        lm.write_lock(tid, second);
+        lm.finish_transaction(tid);
+    } catch (const std::exception& e) {
+        std::println(">> Transaction {} error: {}", tid, e.what());
+    }
+}
+
+int main() {
+    LockManager lm;
+    {
+        std::vector<std::jthread> threads;
+        for (int tid = 0; tid < 4; tid++) {
+            threads.emplace_back(hot_writer, std::ref(lm), tid);
+        }
+        threads.emplace_back(deadlocked, std::ref(lm), 4, 1, 2);
+        threads.emplace_back(deadlocked, std::ref(lm), 5, 2, 1);
+    }
+    lm.begin_transaction(6);
+    lm.write_lock(6, 7);
+    lm.begin_transaction(7, 5ms);
+    std::println(">> Transaction 7 read lock on resource 7: {}", result_name(lm.acquire(7, 7, LockMode::S)));
+    lm.finish_transaction(6);
+
+    LockStats stats = lm.snapshot_stats();
+    std::println(">> grants {} waits {} timeouts {} deadlocks {}", stats[Counter::GRANTS], stats[Counter::WAITS],
+                 stats[Counter::TIMEOUTS], stats[Counter::DEADLOCKS]);
+    std::println(">> aborts: deadlock {} timeout {} protocol {} user {}", stats[AbortCause::DEADLOCK],
+                 stats[AbortCause::TIMEOUT], stats[AbortCause::PROTOCOL_VIOLATION], stats[AbortCause::USER]);
+    const LatencyHistogram& x_waits = stats.wait_time[static_cast<int>(LockMode::X)];
+    std::println(">> X lock waits {}, p50 {} us, p99 {} us", x_waits.count,
+                 std::chrono::duration_cast<std::chrono::microseconds>(x_waits.percentile(0.5)).count(),
+                 std::chrono::duration_cast<std::chrono::microseconds>(x_waits.percentile(0.99)).count());
+    if (!stats.hot.empty()) {
+        std::println(">> Most contended resource {} with about {} waits", stats.hot[0].rid, stats.hot[0].waits);
+    }
+    std::println(">> All transactions completed.");
+    return 0;
+}
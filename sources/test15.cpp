@@ -0,0 +1,118 @@
+#include "lockmanager.h"
+#include <thread>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <coroutine>
+#include <print>
+
+// asynchronous acquisition: five sessions run as coroutines on a single event loop
+// thread. Sessions 1-3 wait for the write lock transaction 0 holds on a plain thread,
+// while the loop keeps serving other work; they resume on the loop one after another.
+// Sessions 4 and 5 deadlock on resources 10 and 11, 5 is the victim and 4 finishes.
+
+using namespace std::chrono_literals;
+
+class EventLoop {
+public:
+    void post(std::function<void()> task) {
+        std::unique_lock<std::mutex> lock(mtx);
+        tasks.push_back(std::move(task));
+        cv.notify_one();
+    }
+
+    Executor executor() {
+        return [this](std::function<void()> task) { post(std::move(task)); };
+    }
+
+    // runs tasks until the given number of sessions have finished
+    void run(int sessions) {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            sessions_left += sessions;
+        }
+        while (true) {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return !tasks.empty() || sessions_left == 0; });
+            if (tasks.empty()) return;
+            auto task = std::move(tasks.front());
+            tasks.pop_front();
+            lock.unlock();
+            task();
+        }
+    }
+
+    void session_done() {
+        std::unique_lock<std::mutex> lock(mtx);
+        sessions_left--;
+        cv.notify_one();
+    }
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    int sessions_left = 0;
+};
+
+// fire and forget coroutine
+struct Session {
+    struct promise_type {
+        Session get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// lets the other sessions on the loop run first
+struct Yield {
+    EventLoop& loop;
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { loop.post([handle] { handle.resume(); }); }
+    void await_resume() {}
+};
+
+Session waiter(LockManager& lm, EventLoop& loop, int tid) {
+    lm.begin_transaction(tid);
+    std::println(">> Session {} is waiting for write lock on resource 0", tid);
+    LockResult result = co_await lm.async_write_lock(tid, 0, loop.executor());
+    std::println(">> Session {} write lock on resource 0: {}", tid, result_name(result));
+    lm.finish_transaction(tid);
+    loop.session_done();
+}
+
+Session crossing(LockManager& lm, EventLoop& loop, int tid, ResourceId first, ResourceId second) {
+    lm.begin_transaction(tid);
+    LockResult result = co_await lm.async_write_lock(tid, first, loop.executor());
+    std::println(">> Session {} write lock on resource {}: {}", tid, first, result_name(result));
+    co_await Yield{loop};
+    result = co_await lm.async_write_lock(tid, second, loop.executor());
+    std::println(">> Session {} write lock on resource {}: {}", tid, second, result_name(result));
+    if (result == LockResult::GRANTED) lm.finish_transaction(tid);   // otherwise already rolled back
+    loop.session_done();
+}
+
+int main() {
+    LockManager lm;
+    EventLoop loop;
+    std::jthread holder([&lm, &loop] {
+        lm.begin_transaction(0);
+        lm.write_lock(0, 0);
+        std::this_thread::sleep_for(100ms);
+        loop.post([] { std::println(">> Event loop is still serving other work"); });
+        std::this_thread::sleep_for(200ms);
+        std::println(">> Transaction 0 releases resource 0");
+        lm.finish_transaction(0);
+    });
+    std::this_thread::sleep_for(50ms);
+    for (int tid = 1; tid <= 3; tid++) {
+        loop.post([&lm, &loop, tid] { waiter(lm, loop, tid); });
+    }
+    loop.post([&lm, &loop] { crossing(lm, loop, 4, 10, 11); });
+    loop.post([&lm, &loop] { crossing(lm, loop, 5, 11, 10); });
+    loop.run(5);
+    std::println(">> All transactions completed.");
+    return 0;
+}
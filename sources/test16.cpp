@@ -0,0 +1,53 @@
+#include "lockmanager.h"
+#include <print>
+
+// lock escalation: with a threshold of 32 locks, transaction 0 writing 100 rows of
+// table 1 ends up holding a single table X lock, which keeps transaction 1 out of the
+// whole table. Transaction 3 cannot escalate while transaction 2 reads a row of table 2
+// and keeps its row locks. With a budget of 64 locks instead, the transaction that
+// pushes the total over the budget escalates, however few locks it holds itself.
+
+int main() {
+    LockManager lm(8, LockManager::DEFAULT_PARTITIONS, {}, {.threshold = 32});
+    lm.begin_transaction(0);
+    for (std::uint32_t row = 0; row < 100; row++) {
+        lm.lock_row(0, 1, row / 25, row % 25, LockMode::X);
+    }
+    std::println(">> Transaction 0 wrote 100 rows, lock table has {} entries", lm.live_entries());
+    lm.begin_transaction(1);
+    std::println(">> Transaction 1 IX lock on table 1: {}",
+                 result_name(lm.try_acquire(1, table_resource(1), LockMode::IX)));
+    lm.finish_transaction(0);
+    lm.lock_row(1, 1, 0, 0, LockMode::X);
+    std::println(">> Transaction 1 locked row (1, 0, 0) after transaction 0 finished");
+    lm.finish_transaction(1);
+
+    lm.begin_transaction(2);
+    lm.lock_row(2, 2, 0, 0, LockMode::S);
+    lm.begin_transaction(3);
+    for (std::uint32_t row = 0; row < 40; row++) {
+        lm.lock_row(3, 2, 1, row, LockMode::X);
+    }
+    std::println(">> Transaction 3 kept its row locks, lock table has {} entries", lm.live_entries());
+    lm.finish_transaction(2);
+    lm.finish_transaction(3);
+    std::println(">> escalations {}", lm.snapshot_stats()[Counter::ESCALATIONS]);
+
+    LockManager budgeted(8, LockManager::DEFAULT_PARTITIONS, {}, {.budget = 64});
+    budgeted.begin_transaction(4);
+    budgeted.begin_transaction(5);
+    for (std::uint32_t row = 0; row < 40; row++) {
+        budgeted.lock_row(4, 4, 0, row, LockMode::S);
+    }
+    for (std::uint32_t row = 0; row < 40; row++) {
+        budgeted.lock_row(5, 5, 0, row, LockMode::X);
+    }
+    std::println(">> Transactions 4 and 5 read and wrote 40 rows each, lock table has {} entries",
+                 budgeted.live_entries());
+    budgeted.finish_transaction(4);
+    budgeted.finish_transaction(5);
+    std::println(">> escalations {}, lock table has {} entries", budgeted.snapshot_stats()[Counter::ESCALATIONS],
+                 budgeted.live_entries());
+    std::println(">> All transactions completed.");
+    return 0;
+}
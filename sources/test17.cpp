@@ -0,0 +1,78 @@
+#include "occ.h"
+#include <thread>
+#include <chrono>
+#include <map>
+#include <print>
+
+// optimistic concurrency control: transactions 0 and 1 both increment resource 1;
+// whichever commits second fails validation and runs again, so no increment is lost.
+// Transaction 2 holds a 2PL write lock on resource 2 and marks its write; transaction
+// 3 read resource 2 before that, so its commit waits for the lock and then fails
+// validation. A read-only transaction commits without taking any lock. Transaction 5
+// reads resource 3 while a 2PL writer keeps it marked, and is aborted instead of
+// waiting for as long as the writer runs.
+
+using namespace std::chrono_literals;
+
+std::map<ResourceId, int> store;
+
+void increment(OccManager& occ, int tid, ResourceId rid) {
+    occ.read(tid, rid);
+    int value = store[rid] + 1;
+    occ.write(tid, rid, [rid, value] { store[rid] = value; });
+}
+
+int main() {
+    LockManager lm;
+    OccManager occ(lm);
+
+    occ.begin_transaction(0);
+    occ.begin_transaction(1);
+    increment(occ, 0, 1);
+    increment(occ, 1, 1);
+    std::println(">> Transaction 0 commit: {}", result_name(occ.commit_transaction(0)));
+    LockResult result = occ.commit_transaction(1);
+    std::println(">> Transaction 1 commit: {}", result_name(result));
+    if (result != LockResult::GRANTED) {
+        occ.begin_transaction(1);
+        increment(occ, 1, 1);
+        std::println(">> Transaction 1 commit on retry: {}", result_name(occ.commit_transaction(1)));
+    }
+    std::println(">> Resource 1 holds {}", store[1]);
+
+    occ.begin_transaction(3);
+    increment(occ, 3, 2);
+    lm.begin_transaction(2);
+    lm.write_lock(2, 2);
+    std::jthread writer([&] {
+        std::this_thread::sleep_for(100ms);
+        occ.begin_write(2);
+        store[2] = 10;
+        occ.end_write(2);
+        std::println(">> Transaction 2 wrote resource 2 under 2PL");
+        lm.finish_transaction(2);
+    });
+    std::println(">> Transaction 3 commit: {}", result_name(occ.commit_transaction(3)));
+    writer.join();
+    std::println(">> Resource 2 holds {}", store[2]);
+
+    occ.begin_transaction(4);
+    occ.read(4, 1);
+    occ.read(4, 2);
+    std::println(">> Read-only transaction 4 commit: {}", result_name(occ.commit_transaction(4)));
+
+    lm.begin_transaction(6);
+    lm.write_lock(6, 3);
+    occ.begin_write(3);
+    occ.begin_transaction(5);
+    try {
+        occ.read(5, 3);
+        std::println(">> Transaction 5 read resource 3 while it was being written");
+    } catch (const std::exception& e) {
+        std::println(">> Transaction 5 read of resource 3 while it is being written: {}", e.what());
+    }
+    occ.end_write(3);
+    lm.finish_transaction(6);
+    std::println(">> All transactions completed.");
+    return 0;
+}
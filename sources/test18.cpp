@@ -0,0 +1,172 @@
+#include "sharedlockmanager.h"
+#include <chrono>
+#include <cstdio>
+#include <print>
+#include <thread>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// shared lock table: a child process write-locks resource 1 and holds it for 200 ms,
+// the parent's write lock on it waits until the child finishes. A second child locks
+// resource 2 and exits without finishing its transaction, as if it had crashed; the
+// parent's lock request times out, which reclaims the dead child's transaction, and
+// the retry is granted. A table with room for two lock requests fails the third with
+// a result rather than an exception. The sole reader of resource 3 upgrades at once
+// while a child's write lock on it is queued, and the child gets it once the reader
+// finishes. Children only print and exit with _exit, so
+// nothing is flushed or destroyed twice.
+//
+// Then pairs of children run transactions on eight resources of a one-partition
+// table without pause and are killed, some of them while holding its latch. After
+// each pair the parent locks all eight resources at once and the table is empty
+// again, and at the end every entry and request of the full table can be used.
+
+using namespace std::chrono_literals;
+
+constexpr const char* SEGMENT = "/lockmanager_test18";
+constexpr const char* SMALL_SEGMENT = "/lockmanager_test18_small";
+constexpr const char* KILL_SEGMENT = "/lockmanager_test18_kill";
+
+pid_t spawn(void (*body)(SharedLockManager&)) {
+    std::fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        SharedLockManager lm(SEGMENT);
+        body(lm);
+        std::fflush(stdout);
+        _exit(0);
+    }
+    return pid;
+}
+
+void holder(SharedLockManager& lm) {
+    int tid = lm.begin_transaction();
+    lm.write_lock(tid, 1);
+    std::println(">> Child transaction {} locked resource 1", tid);
+    std::fflush(stdout);
+    std::this_thread::sleep_for(200ms);
+    lm.finish_transaction(tid);
+}
+
+void writer(SharedLockManager& lm) {
+    int tid = lm.begin_transaction();
+    LockResult result = lm.acquire(tid, 3, LockMode::X);
+    std::println(">> Child transaction {} write lock on resource 3: {}", tid, result_name(result));
+    lm.finish_transaction(tid);
+}
+
+void crasher(SharedLockManager& lm) {
+    int tid = lm.begin_transaction();
+    lm.write_lock(tid, 2);
+    std::println(">> Child transaction {} locked resource 2 and exits", tid);
+}
+
+[[noreturn]] void churn(unsigned seed) {
+    SharedLockManager lm(KILL_SEGMENT, {.lock_timeout = 20ms});
+    for (unsigned n = seed; ; n = n * 1103515245 + 12345) {
+        int tid = lm.begin_transaction();
+        for (int i = 0; i < 3; i++) {
+            LockMode mode = (n >> (24 + i)) & 1 ? LockMode::X : LockMode::S;
+            if (lm.acquire(tid, 1 + (n >> (4 * i)) % 8, mode) != LockResult::GRANTED) break;
+        }
+        lm.finish_transaction(tid);
+    }
+}
+
+int main() {
+    SharedLockManager::remove(SEGMENT);
+    SharedLockManager lm(SEGMENT, {.num_transactions = 8, .lock_timeout = 500ms});
+
+    pid_t child = spawn(holder);
+    std::this_thread::sleep_for(50ms);
+    int tid = lm.begin_transaction();
+    auto start = std::chrono::steady_clock::now();
+    lm.write_lock(tid, 1);
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::println(">> Transaction {} locked resource 1 after waiting {} ms", tid, waited.count() >= 100 ? "over 100" : "under 100");
+    lm.finish_transaction(tid);
+    waitpid(child, nullptr, 0);
+
+    child = spawn(crasher);
+    waitpid(child, nullptr, 0);
+    tid = lm.begin_transaction();
+    LockResult result = lm.acquire(tid, 2, LockMode::X);
+    std::println(">> Transaction {} write lock on resource 2: {}", tid, result_name(result));
+    if (result != LockResult::GRANTED) {
+        lm.finish_transaction(tid);
+        tid = lm.begin_transaction();
+        std::println(">> Transaction {} write lock on resource 2 on retry: {}", tid,
+                     result_name(lm.acquire(tid, 2, LockMode::X)));
+    }
+    lm.finish_transaction(tid);
+
+    tid = lm.begin_transaction();
+    lm.read_lock(tid, 3);
+    child = spawn(writer);
+    std::this_thread::sleep_for(50ms);
+    start = std::chrono::steady_clock::now();
+    result = lm.acquire(tid, 3, LockMode::X);
+    waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::println(">> Transaction {} upgrade on resource 3: {} after waiting {} ms", tid, result_name(result),
+                 waited.count() >= 100 ? "over 100" : "under 100");
+    std::fflush(stdout);
+    lm.finish_transaction(tid);
+    waitpid(child, nullptr, 0);
+    std::println(">> Shared lock table has {} entries", lm.live_entries());
+
+    SharedLockManager::remove(SEGMENT);
+
+    SharedLockManager::remove(SMALL_SEGMENT);
+    {
+        SharedLockManager small(SMALL_SEGMENT, {.num_transactions = 2, .num_partitions = 1, .requests_per_partition = 2});
+        tid = small.begin_transaction();
+        for (ResourceId rid = 1; rid <= 3; rid++) {
+            LockResult result = small.acquire(tid, rid, LockMode::S);
+            std::println(">> Transaction {} read lock on resource {}: {}", tid, rid, result_name(result));
+            if (result != LockResult::GRANTED) break;
+        }
+        small.finish_transaction(tid);
+        std::println(">> Small shared lock table has {} entries", small.live_entries());
+    }
+    SharedLockManager::remove(SMALL_SEGMENT);
+
+    SharedLockManager::remove(KILL_SEGMENT);
+    {
+        SharedLockManager shared(KILL_SEGMENT, {.num_transactions = 8, .num_partitions = 1,
+                                                .entries_per_partition = 8, .requests_per_partition = 16});
+        bool consistent = true;
+        for (unsigned round = 0; round < 50 && consistent; round++) {
+            pid_t children[2];
+            for (unsigned c = 0; c < 2; c++) {
+                std::fflush(stdout);
+                children[c] = fork();
+                if (children[c] == 0) churn(2 * round + c);
+            }
+            std::this_thread::sleep_for(10ms);
+            for (pid_t c : children) kill(c, SIGKILL);
+            for (pid_t c : children) waitpid(c, nullptr, 0);
+            shared.reclaim_stale();
+            tid = shared.begin_transaction();
+            for (ResourceId rid = 1; rid <= 8 && consistent; rid++) {
+                consistent = shared.acquire(tid, rid, LockMode::X) == LockResult::GRANTED;
+            }
+            shared.finish_transaction(tid);
+            consistent = consistent && shared.live_entries() == 0;
+        }
+        std::println(">> Shared lock table after killing children mid-transaction: {}",
+                     consistent ? "consistent" : "damaged");
+        int first = shared.begin_transaction(), second = shared.begin_transaction();
+        int granted = 0;
+        for (ResourceId rid = 1; rid <= 8; rid++) {
+            granted += shared.acquire(first, rid, LockMode::S) == LockResult::GRANTED;
+            granted += shared.acquire(second, rid, LockMode::S) == LockResult::GRANTED;
+        }
+        std::println(">> {} of 16 read locks granted in the full table", granted);
+        shared.finish_transaction(first);
+        shared.finish_transaction(second);
+    }
+    SharedLockManager::remove(KILL_SEGMENT);
+    std::println(">> All transactions completed.");
+    return 0;
+}
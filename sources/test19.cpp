@@ -0,0 +1,85 @@
+#include "lockmanager.h"
+#include <chrono>
+#include <print>
+#include <thread>
+
+// key-range locks: transaction 0 read-locks the keys [100, 200] as a scan would.
+// Transaction 1 cannot write key 150 inside the range and times out, transaction 2
+// writes key 250 outside it and shares the range itself. Transaction 3 writing key 120
+// waits until transaction 0 finishes. Then transactions 4 and 5 each write one key and
+// read a range covering the other's, which deadlocks; one of them is rolled back.
+// The same deadlock under background detection is broken by the detector thread.
+
+using namespace std::chrono_literals;
+
+int main() {
+    LockManager lm(8);
+    lm.begin_transaction(0);
+    lm.lock_range(0, 100, 200, LockMode::S);
+    std::println(">> Transaction 0 read-locked keys [100, 200]");
+
+    lm.begin_transaction(1, 20ms);
+    std::println(">> Transaction 1 write lock on key 150: {}", result_name(lm.acquire_range(1, 150, 150, LockMode::X)));
+    lm.finish_transaction(1);
+
+    lm.begin_transaction(2);
+    std::println(">> Transaction 2 write lock on key 250: {}", result_name(lm.acquire_range(2, 250, 250, LockMode::X)));
+    std::println(">> Transaction 2 read lock on keys [150, 300]: {}",
+                 result_name(lm.acquire_range(2, 150, 300, LockMode::S)));
+    lm.finish_transaction(2);
+
+    {
+        std::jthread writer([&lm] {
+            lm.begin_transaction(3);
+            auto start = std::chrono::steady_clock::now();
+            lm.lock_key(3, 120, LockMode::X);
+            auto waited = std::chrono::steady_clock::now() - start;
+            std::println(">> Transaction 3 wrote key 120 after waiting {} ms", waited >= 50ms ? "over 50" : "under 50");
+            lm.finish_transaction(3);
+        });
+        std::this_thread::sleep_for(100ms);
+        std::println(">> Transaction 0 finishes");
+        lm.finish_transaction(0);
+    }
+
+    lm.begin_transaction(4);
+    lm.begin_transaction(5);
+    lm.lock_key(4, 10, LockMode::X);
+    lm.lock_key(5, 20, LockMode::X);
+    LockResult first, second;
+    {
+        std::jthread reader([&] {
+            first = lm.acquire_range(4, 15, 25, LockMode::S);
+            if (first == LockResult::GRANTED) lm.finish_transaction(4);
+        });
+        std::this_thread::sleep_for(50ms);
+        second = lm.acquire_range(5, 5, 12, LockMode::S);
+        lm.finish_transaction(5);
+    }
+    if (first != LockResult::GRANTED) lm.finish_transaction(4);
+    std::println(">> Transaction 4 read lock on keys [15, 25]: {}", result_name(first));
+    std::println(">> Transaction 5 read lock on keys [5, 12]: {}", result_name(second));
+
+    DeadlockOptions options;
+    options.mode = DetectionMode::BACKGROUND;
+    options.interval = 5ms;
+    LockManager background(2, LockManager::DEFAULT_PARTITIONS, options);
+    background.begin_transaction(0);
+    background.begin_transaction(1);
+    background.lock_key(0, 10, LockMode::X);
+    background.lock_key(1, 20, LockMode::X);
+    {
+        std::jthread reader([&] {
+            first = background.acquire_range(0, 15, 25, LockMode::S);
+            if (first == LockResult::GRANTED) background.finish_transaction(0);
+        });
+        std::this_thread::sleep_for(50ms);
+        second = background.acquire_range(1, 5, 12, LockMode::S);
+        background.finish_transaction(1);
+    }
+    if (first != LockResult::GRANTED) background.finish_transaction(0);
+    std::println(">> Background detection: one of the two range reads rolled back: {}",
+                 (first == LockResult::DEADLOCK_VICTIM) != (second == LockResult::DEADLOCK_VICTIM));
+    std::println(">> All transactions completed.");
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "lockrecorder.h"
+#include <chrono>
+#include <cstdio>
+#include <print>
+#include <thread>
+
+// lock event recording: transaction 0 write-locks resource 1 and unlocks it after
+// 100 ms, transaction 1 waits for its read lock meanwhile, and transaction 2 fails a
+// try on resource 2 that transaction 1 holds, then aborts. The trace is read back and
+// printed one transaction at a time; the request and grant of transaction 1 are
+// 100 ms apart. With a threshold of 4 locks, transaction 3 reading rows of table 1
+// escalates to a table lock, recorded as a try on the table and the unlocks of the
+// page and rows, and its downgrade of resource 3 is recorded as a grant of S.
+
+using namespace std::chrono_literals;
+
+constexpr const char* TRACE_FILE = "test20.trace";
+
+int main() {
+    {
+        LockRecorder recorder(TRACE_FILE, 64);
+        LockManager lm(4, LockManager::DEFAULT_PARTITIONS, {}, {.threshold = 4});
+        lm.set_recorder(&recorder);
+        lm.begin_transaction(0);
+        lm.write_lock(0, 1);
+        {
+            std::jthread reader([&lm] {
+                lm.begin_transaction(1);
+                lm.write_lock(1, 2);
+                lm.read_lock(1, 1);
+                std::this_thread::sleep_for(50ms);
+                lm.finish_transaction(1);
+            });
+            std::this_thread::sleep_for(100ms);
+            lm.unlock(0, 1);
+            lm.finish_transaction(0);
+            std::this_thread::sleep_for(20ms);
+            lm.begin_transaction(2);
+            std::println(">> Transaction 2 write lock on resource 2: {}",
+                         result_name(lm.try_acquire(2, 2, LockMode::X)));
+            try {
+                lm.abort_transaction(2);
+            } catch (const std::runtime_error&) {
+            }
+        }
+        lm.begin_transaction(3);
+        for (std::uint32_t row = 0; row < 4; row++) lm.lock_row(3, 1, 0, row, LockMode::S);
+        lm.write_lock(3, 3);
+        lm.downgrade_lock(3, 3);
+        lm.finish_transaction(3);
+        lm.set_recorder(nullptr);
+        std::println(">> Recorded {} events", recorder.recorded());
+    }
+
+    LockTrace trace(TRACE_FILE);
+    std::uint64_t requested = 0;
+    for (int tid = 0; tid < 4; tid++) {
+        for (const LockEvent& e : trace.events()) {
+            if (e.tid != tid) continue;
+            if (e.kind == LockEventKind::BEGIN || e.kind == LockEventKind::ABORT || e.kind == LockEventKind::FINISH) {
+                std::println(">> Transaction {} {}", tid, event_name(e.kind));
+            } else if (e.kind == LockEventKind::RELEASE) {
+                std::println(">> Transaction {} release resource {}{}", tid, e.rid, e.flags & EVENT_END ? " at the end" : "");
+            } else {
+                std::println(">> Transaction {} {} {} lock on resource {}{}", tid, event_name(e.kind),
+                             mode_name(static_cast<LockMode>(e.mode)), e.rid, e.flags & EVENT_TRY ? ", try"
+                             : e.flags & EVENT_DOWNGRADE ? ", downgrade" : "");
+            }
+            if (tid == 1 && e.kind == LockEventKind::REQUEST && e.rid == 1) requested = e.time;
+            if (tid == 1 && e.kind == LockEventKind::GRANT && e.rid == 1) {
+                std::println(">> Transaction 1 waited {} ms", std::chrono::nanoseconds(e.time - requested) >= 80ms
+                                                                  ? "over 80" : "under 80");
+            }
+        }
+    }
+    std::remove(TRACE_FILE);
+    std::println(">> All transactions completed.");
+    return 0;
+}
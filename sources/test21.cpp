@@ -0,0 +1,45 @@
+#include "lockmanager.h"
+#include <chrono>
+#include <print>
+#include <thread>
+
+// youngest-victim policy across a restart: transactions 0, 1 and 2 begin in that
+// order. Transactions 0 and 1 deadlock and the younger, 1, is rolled back. It begins
+// again, later than transaction 2, and deadlocks with it; it keeps its age through the
+// restart, so this time transaction 2 is the younger one and the victim.
+
+using namespace std::chrono_literals;
+
+// a and b each write-lock one resource and then the other's; returns the victim
+int deadlock(LockManager& lm, int a, int b, ResourceId ra, ResourceId rb) {
+    lm.write_lock(a, ra);
+    lm.write_lock(b, rb);
+    LockResult a_result, b_result;
+    {
+        std::jthread waiter([&] { b_result = lm.acquire(b, ra, LockMode::X); });
+        std::this_thread::sleep_for(50ms);
+        a_result = lm.acquire(a, rb, LockMode::X);
+    }
+    int victim = a_result != LockResult::GRANTED ? a : b;
+    lm.finish_transaction(victim == a ? b : a);
+    return victim;
+}
+
+int main() {
+    DeadlockOptions options;
+    options.victim_policy = VictimPolicy::YOUNGEST;
+    LockManager lm(3, LockManager::DEFAULT_PARTITIONS, options);
+    lm.begin_transaction(0);
+    lm.begin_transaction(1);
+    lm.begin_transaction(2);
+
+    std::println(">> Deadlock of transactions 0 and 1, victim {}", deadlock(lm, 0, 1, 10, 11));
+    std::this_thread::sleep_for(10ms);
+    lm.begin_transaction(1);
+    std::println(">> Transaction 1 restarted");
+    int victim = deadlock(lm, 1, 2, 20, 21);
+    std::println(">> Deadlock of transactions 1 and 2, victim {}", victim);
+    lm.finish_transaction(victim);
+    std::println(">> All transactions completed.");
+    return 0;
+}
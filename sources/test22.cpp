@@ -0,0 +1,59 @@
+#include "lockmanager.h"
+#include <print>
+
+// thin locks: transaction 0 read-locks resource 1 as a thin lock and transaction 1's
+// read lock inflates it, so both hold it and a writer is turned away. Transaction 2
+// converts its thin read lock on resource 2 to a write lock in place. Once the readers
+// finish, resource 1 deflates and a writer takes it again.
+// With a single partition, 200 resources locked and released leave idle entries that
+// the next 200 resources reuse; a resource whose cached entry now serves another one
+// still gets an entry of its own, so locks on the two never conflict.
+
+int main() {
+    {
+        LockManager lm(4);
+        lm.begin_transaction(0);
+        lm.begin_transaction(1);
+        lm.begin_transaction(2);
+        lm.begin_transaction(3);
+        std::println(">> Transaction 0 read lock on resource 1: {}", result_name(lm.try_acquire(0, 1, LockMode::S)));
+        std::println(">> Transaction 1 read lock on resource 1: {}", result_name(lm.try_acquire(1, 1, LockMode::S)));
+        std::println(">> Transaction 3 write lock on resource 1: {}", result_name(lm.try_acquire(3, 1, LockMode::X)));
+
+        std::println(">> Transaction 2 read lock on resource 2: {}", result_name(lm.try_acquire(2, 2, LockMode::S)));
+        std::println(">> Transaction 2 upgrade on resource 2: {}", result_name(lm.try_acquire(2, 2, LockMode::X)));
+        std::println(">> Transaction 3 read lock on resource 2: {}", result_name(lm.try_acquire(3, 2, LockMode::S)));
+
+        lm.finish_transaction(0);
+        lm.finish_transaction(1);
+        std::println(">> Transaction 3 write lock on resource 1 after the readers: {}",
+                     result_name(lm.try_acquire(3, 1, LockMode::X)));
+        lm.finish_transaction(2);
+        lm.finish_transaction(3);
+        std::println(">> Lock table has {} entries", lm.live_entries());
+    }
+
+    {
+        LockManager lm(2, 1);
+        lm.begin_transaction(0);
+        for (ResourceId rid = 0; rid < 200; rid++) lm.write_lock(0, rid);
+        lm.finish_transaction(0);
+        lm.begin_transaction(0);
+        for (ResourceId rid = 1000; rid < 1200; rid++) lm.write_lock(0, rid);
+        lm.begin_transaction(1);
+        int granted = 0, blocked = 0;
+        for (ResourceId rid = 0; rid < 200; rid++) {
+            granted += lm.try_acquire(1, rid, LockMode::X) == LockResult::GRANTED;
+        }
+        for (ResourceId rid = 1000; rid < 1200; rid++) {
+            blocked += lm.try_acquire(1, rid, LockMode::X) == LockResult::WOULD_BLOCK;
+        }
+        std::println(">> Old resources granted: {}, new resources blocked: {}", granted, blocked);
+        std::println(">> Lock table has {} entries", lm.live_entries());
+        lm.finish_transaction(0);
+        lm.finish_transaction(1);
+        std::println(">> Lock table has {} entries", lm.live_entries());
+    }
+    std::println(">> All transactions completed.");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "lockmanager.h"
+#include <atomic>
+#include <chrono>
+#include <print>
+#include <thread>
+#include <vector>
+
+// shared readers: four reader threads read-lock resource 1 and each waits, still
+// holding it, until all four do. Then transaction 0 write-locks resource 2, four
+// readers queue behind it and a writer queues behind them. Releasing the write lock
+// grants the four readers together, while the writer keeps waiting until they finish.
+
+using namespace std::chrono_literals;
+
+constexpr int READERS = 4;
+
+// true once count reaches n, false if that takes longer than a second
+bool wait_for(const std::atomic<int>& count, int n) {
+    auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (count < n && std::chrono::steady_clock::now() < deadline) std::this_thread::sleep_for(1ms);
+    return count >= n;
+}
+
+int main() {
+    LockManager lm(READERS + 2);
+    std::atomic<int> holding{0};
+    std::atomic<bool> together{true};
+    {
+        std::vector<std::jthread> readers;
+        for (int tid = 0; tid < READERS; tid++) {
+            readers.emplace_back([&, tid] {
+                lm.begin_transaction(tid);
+                lm.read_lock(tid, 1);
+                holding++;
+                if (!wait_for(holding, READERS)) together = false;
+                lm.finish_transaction(tid);
+            });
+        }
+    }
+    std::println(">> {} readers held resource 1 together: {}", READERS, together.load());
+
+    holding = 0;
+    together = true;
+    std::atomic<int> released{0};
+    std::atomic<bool> writer_after_readers{false};
+    lm.begin_transaction(READERS);
+    lm.write_lock(READERS, 2);
+    {
+        std::vector<std::jthread> threads;
+        for (int tid = 0; tid < READERS; tid++) {
+            threads.emplace_back([&, tid] {
+                lm.begin_transaction(tid);
+                lm.read_lock(tid, 2);
+                holding++;
+                if (!wait_for(holding, READERS)) together = false;
+                released++;
+                lm.finish_transaction(tid);
+            });
+        }
+        std::this_thread::sleep_for(50ms);
+        threads.emplace_back([&] {
+            lm.begin_transaction(READERS + 1);
+            lm.write_lock(READERS + 1, 2);
+            writer_after_readers = released == READERS;
+            lm.finish_transaction(READERS + 1);
+        });
+        std::this_thread::sleep_for(50ms);
+        std::println(">> Readers holding resource 2 while it is write-locked: {}", holding.load());
+        lm.finish_transaction(READERS);
+    }
+    std::println(">> One release granted all {} queued readers: {}", READERS, together.load());
+    std::println(">> Queued writer granted after the readers: {}", writer_after_readers.load());
+    std::println(">> All transactions completed.");
+    return 0;
+}
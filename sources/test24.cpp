@@ -0,0 +1,61 @@
+#include "lockmanager.h"
+#include <atomic>
+#include <chrono>
+#include <print>
+#include <thread>
+#include <vector>
+
+// targeted wakeups: four writers queue for resource 1 behind transaction 0's write
+// lock. Each release wakes only the one writer it grants, the others sleep on, so
+// the four grants take four wakeups. In a deadlock the victim is woken once, on the
+// entry it waits on, and its rollback wakes the other transaction with the grant.
+
+using namespace std::chrono_literals;
+
+std::uint64_t wakeups(const LockManager& lm) {
+    return lm.snapshot_stats()[Counter::WAKEUPS];
+}
+
+int main() {
+    LockManager lm(5);
+    std::atomic<int> granted{0};
+    lm.begin_transaction(0);
+    lm.write_lock(0, 1);
+    {
+        std::vector<std::jthread> writers;
+        for (int tid = 1; tid <= 4; tid++) {
+            writers.emplace_back([&, tid] {
+                lm.begin_transaction(tid);
+                lm.write_lock(tid, 1);
+                granted++;
+                std::this_thread::sleep_for(100ms);
+                lm.finish_transaction(tid);
+            });
+            std::this_thread::sleep_for(20ms);
+        }
+        std::uint64_t before = wakeups(lm);
+        lm.finish_transaction(0);
+        std::this_thread::sleep_for(50ms);
+        std::println(">> One release: {} writer granted, {} wakeup", granted.load(), wakeups(lm) - before);
+    }
+    std::println(">> Four writers granted in turn, {} wakeups in all", wakeups(lm));
+
+    LockManager detect(2);
+    detect.begin_transaction(0);
+    detect.begin_transaction(1);
+    detect.write_lock(0, 1);
+    detect.write_lock(1, 2);
+    std::uint64_t before = wakeups(detect);
+    LockResult first, second;
+    {
+        std::jthread waiter([&] { second = detect.acquire(1, 1, LockMode::X); });
+        std::this_thread::sleep_for(50ms);
+        first = detect.acquire(0, 2, LockMode::X);
+    }
+    std::println(">> Deadlock: transaction 0 {}, transaction 1 {}, {} wakeups", result_name(first),
+                 result_name(second), wakeups(detect) - before);
+    detect.finish_transaction(0);
+    detect.finish_transaction(1);
+    std::println(">> All transactions completed.");
+    return 0;
+}
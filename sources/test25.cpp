@@ -0,0 +1,48 @@
+#include "lockmanager.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <print>
+#include <thread>
+#include <vector>
+
+// a request leaving the middle of a wait queue: transactions 1, 2 and 3 queue in that
+// order for resource 1, which transaction 0 write-locks. Transaction 2 gives up after
+// 100 ms and is unlinked from between the other two, which are still granted in
+// their queue order once transaction 0 finishes.
+
+using namespace std::chrono_literals;
+
+int main() {
+    LockManager lm(4);
+    std::mutex order_mtx;
+    std::vector<int> order;
+    std::atomic<LockResult> middle{LockResult::PENDING};
+    lm.begin_transaction(0);
+    lm.write_lock(0, 1);
+    {
+        std::vector<std::jthread> waiters;
+        for (int tid = 1; tid <= 3; tid++) {
+            waiters.emplace_back([&, tid] {
+                lm.begin_transaction(tid);
+                LockResult result = tid == 2 ? lm.acquire(tid, 1, LockMode::X, 100ms) : lm.acquire(tid, 1, LockMode::X);
+                if (tid == 2) {
+                    middle = result;
+                } else {
+                    std::unique_lock<std::mutex> lock(order_mtx);
+                    order.push_back(tid);
+                }
+                std::this_thread::sleep_for(10ms);
+                lm.finish_transaction(tid);
+            });
+            std::this_thread::sleep_for(20ms);
+        }
+        std::this_thread::sleep_for(200ms);
+        std::println(">> Transaction 2 in the middle of the queue: {}", result_name(middle.load()));
+        lm.finish_transaction(0);
+    }
+    std::println(">> Granted in order: {} then {}", order[0], order[1]);
+    std::println(">> Lock table has {} entries", lm.live_entries());
+    std::println(">> All transactions completed.");
+    return 0;
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Leveled tracing for the lock manager. A trace call at or below LOCKMANAGER_TRACE_LEVEL
+// formats its message into a ring buffer owned by the calling thread; a background
+// flusher prints the buffers in time order, so no thread writes to stdout while it holds
+// a lock manager mutex. Build with -DLOCKMANAGER_TRACE_LEVEL=0 to compile every call out.
+
+#ifndef LOCKMANAGER_TRACE_LEVEL
+#define LOCKMANAGER_TRACE_LEVEL 3
+#endif
+
+enum class TraceLevel { OFF, ERROR, INFO, DEBUG };
+
+inline constexpr TraceLevel TRACE_LEVEL = static_cast<TraceLevel>(LOCKMANAGER_TRACE_LEVEL);
+
+struct TraceRecord {
+    std::int64_t time;                                  // steady clock ticks, orders records across threads
+    std::uint32_t length;
+    char text[244];
+};
+
+// single producer (the owning thread), single consumer (whoever flushes)
+class TraceRing {
+public:
+    static constexpr std::size_t CAPACITY = 512;        // power of two
+
+    std::atomic<bool> retired{false};                   // owning thread has exited
+    std::atomic<std::uint64_t> dropped{0};              // records lost to a full ring
+
+    void push(const TraceRecord& record) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);   // never block the traced thread
+            return;
+        }
+        records[h & (CAPACITY - 1)] = record;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    void drain(std::vector<TraceRecord>& out) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t h = head.load(std::memory_order_acquire);
+        for (; t != h; t++) {
+            out.push_back(records[t & (CAPACITY - 1)]);
+        }
+        tail.store(t, std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    std::array<TraceRecord, CAPACITY> records;
+};
+
+class TraceSink {
+public:
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{1};
+
+    static TraceSink& instance() {
+        static TraceSink sink;
+        return sink;
+    }
+
+    TraceRing& local_ring() {
+        thread_local Registration registration(*this);
+        return *registration.ring;
+    }
+
+    // print everything traced so far, safe to call from any thread
+    void flush() {
+        std::vector<std::shared_ptr<TraceRing>> snapshot;
+        {
+            std::unique_lock<std::mutex> lock(rings_mtx);
+            snapshot = rings;
+        }
+
+        std::unique_lock<std::mutex> lock(flush_mtx);
+        std::vector<TraceRecord> batch;
+        std::uint64_t dropped = 0;
+        for (const auto& ring : snapshot) {
+            ring->drain(batch);
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+        }
+        std::stable_sort(batch.begin(), batch.end(),
+                         [](const TraceRecord& a, const TraceRecord& b) { return a.time < b.time; });
+
+        std::string out;
+        for (const TraceRecord& record : batch) {
+            out.append(record.text, record.length);
+            out.push_back('\n');
+        }
+        if (dropped) out += std::format("[trace] {} records dropped\n", dropped);
+        if (!out.empty()) {
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+        }
+
+        std::unique_lock<std::mutex> rings_lock(rings_mtx);
+        std::erase_if(rings, [](const auto& ring) { return ring->retired && ring->empty(); });
+    }
+
+    ~TraceSink() {
+        flusher.request_stop();
+        flusher.join();
+        flush();
+    }
+
+private:
+    struct Registration {
+        std::shared_ptr<TraceRing> ring = std::make_shared<TraceRing>();
+
+        explicit Registration(TraceSink& sink) {
+            std::unique_lock<std::mutex> lock(sink.rings_mtx);
+            sink.rings.push_back(ring);
+        }
+        ~Registration() { ring->retired = true; }
+    };
+
+    std::mutex rings_mtx;                               // guards rings, taken once per thread and per flush
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    std::mutex flush_mtx;                               // one consumer at a time
+    std::jthread flusher;
+
+    TraceSink() {
+        flusher = std::jthread([this](std::stop_token stop) {
+            std::mutex sleep_mtx;
+            std::condition_variable_any sleep_cv;
+            std::unique_lock<std::mutex> sleep_lock(sleep_mtx);
+            while (!sleep_cv.wait_for(sleep_lock, stop, FLUSH_INTERVAL, [] { return false; }) &&
+                   !stop.stop_requested()) {
+                flush();
+            }
+        });
+    }
+};
+
+template <TraceLevel Level, typename... Args>
+inline void trace(std::format_string<Args...> fmt, Args&&... args) {
+    if constexpr (Level != TraceLevel::OFF && Level <= TRACE_LEVEL) {
+        TraceRecord record;
+        record.time = std::chrono::steady_clock::now().time_since_epoch().count();
+        auto result = std::format_to_n(record.text, sizeof(record.text), fmt, std::forward<Args>(args)...);
+        record.length = static_cast<std::uint32_t>(std::min<std::ptrdiff_t>(result.size, sizeof(record.text)));
+        TraceSink::instance().local_ring().push(record);
+    }
+}
+
+inline void trace_flush() {
+    if constexpr (TRACE_LEVEL != TraceLevel::OFF) {
+        TraceSink::instance().flush();
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+// YCSB's Zipfian generator (Gray et al.), item 0 is the most popular
+class Zipf {
+public:
+    Zipf(std::uint64_t n, double theta) : n(n), theta(std::min(theta, 0.999)) {
+        for (std::uint64_t i = 1; i <= n; i++) zetan += 1.0 / std::pow(static_cast<double>(i), this->theta);
+        double zeta2 = 1.0 + 1.0 / std::pow(2.0, this->theta);
+        alpha = 1.0 / (1.0 - this->theta);
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - this->theta)) / (1.0 - zeta2 / zetan);
+    }
+
+    std::uint64_t operator()(std::mt19937_64& rng) const {
+        if (theta <= 0) return rng() % n;
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta)) return 1;
+        return std::min<std::uint64_t>(n - 1, static_cast<std::uint64_t>(n * std::pow(eta * u - eta + 1.0, alpha)));
+    }
+
+private:
+    std::uint64_t n;
+    double theta;
+    double zetan = 0, alpha = 0, eta = 0;
+};